@@ -3,7 +3,10 @@
 #include "imgui.h"
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_sdlrenderer3.h"
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdexcept>
 #include <vector>
 #include <ranges>
@@ -12,27 +15,19 @@
 #include <SDL3/SDL.h>
 #include <glm/gtc/matrix_transform.hpp>
 
-static void SetDarkThemeColors();
+#include "engine/WorkerPool.h"
 
-static uint32_t ToColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
-{
-	// RGBA8888 format: R in bits 24-31, G in bits 16-23, B in bits 8-15, A in bits 0-7
-	return (r << 24) | (g << 16) | (b << 8) | (a << 0);
-}
+static void SetDarkThemeColors();
 
-static float random_float(uint32_t &state)
+static Color ToSamplerColor(const ImVec4 &color)
 {
-	uint32_t result;
-
-	state = state * 747796405 + 2891336453;
-	result = ((state >> ((state >> 28) + 4)) ^ state) * 277803737;
-	result = (result >> 22) ^ result;
-	return ((float)result / 4294967295.0f);
+	return {(uint8_t)(color.x * 255.0f), (uint8_t)(color.y * 255.0f), (uint8_t)(color.z * 255.0f)};
 }
 
 App *App::s_Instance = nullptr;
 
-App::App()
+App::App(const char *checkpoint_path, const char *attach_path, const char *metrics_address)
+	: m_simulation(m_texture_sizes[m_texture_size_preset], WorkerPool::hardware_threads())
 {
 	assert(s_Instance == nullptr && "App already exists!");
 	s_Instance = this;
@@ -88,22 +83,82 @@ App::App()
 	ImGui_ImplSDL3_InitForSDLRenderer(m_window, m_renderer);
 	ImGui_ImplSDLRenderer3_Init(m_renderer);
 
+	// Only offer the texture sizes the renderer can create
+	int64_t max_texture_size = SDL_GetNumberProperty(SDL_GetRendererProperties(m_renderer), SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0);
+	if (max_texture_size > 0)
+		m_texture_size_count = std::max(1, (int)std::ranges::count_if(m_texture_sizes, [&](int size) { return size <= max_texture_size; }));
+	if (m_texture_size_preset >= m_texture_size_count)
+	{
+		m_texture_size_preset = m_texture_size_count - 1;
+		m_simulation.reset((uint32_t)m_texture_sizes[m_texture_size_preset]);
+	}
+
 	// Initialize with default preset size (512x512)
-	int default_size = m_texture_sizes[m_texture_size_preset];
-	m_viewport_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, default_size, default_size);
+	if (!create_viewport_texture(m_texture_sizes[m_texture_size_preset]))
+		throw std::runtime_error("Failed to create the viewport texture");
 
-	// Disable texture filtering to see individual pixels
-	SDL_SetTextureScaleMode(m_viewport_texture, SDL_SCALEMODE_NEAREST);
+	m_simulation.set_colors(ToSamplerColor(m_inside_color), ToSamplerColor(m_outside_color));
+	apply_batch_mode();
+	apply_target_precision();
+	m_thread_count = (int)WorkerPool::hardware_threads();
 
-	// Initialize texture and accumulation buffers
-	int pixel_count = default_size * default_size;
-	m_viewport_data.resize(pixel_count);
-	m_accumulation_r.resize(pixel_count, 0);
-	m_accumulation_g.resize(pixel_count, 0);
-	m_accumulation_b.resize(pixel_count, 0);
-	m_sample_counts.resize(pixel_count, 0);
-	std::fill(m_viewport_data.begin(), m_viewport_data.end(), ToColor(0, 0, 0, 255));
-	SDL_UpdateTexture(m_viewport_texture, nullptr, m_viewport_data.data(), default_size * 4);
+	if (checkpoint_path)
+	{
+		m_checkpoint_path = checkpoint_path;
+		SamplerState state;
+		if (read_checkpoint(checkpoint_path, state))
+		{
+			SDL_Log("Resuming %llu points from %s\n", (unsigned long long)state.total_points, checkpoint_path);
+			// The checkpoint holds the grid, which can be finer than the texture. Keep the
+			// texture size when the grid can be summed to it, else show the grid itself.
+			uint32_t display_size = (uint32_t)m_texture_sizes[m_texture_size_preset];
+			if (!Sampler::can_display(state.size, display_size, state.strategy))
+			{
+				display_size = state.size;
+				auto preset = std::ranges::find(m_texture_sizes, (int)state.size);
+				if (preset != m_texture_sizes.end())
+					m_texture_size_preset = (int)(preset - m_texture_sizes.begin());
+			}
+			m_sampling_mode = state.mode;
+			m_sampling_strategy = state.strategy;
+			m_simulation.restore(std::move(state));
+			m_simulation.set_display_size(display_size);
+		}
+		m_simulation.set_checkpoint(m_checkpoint_path, m_checkpoint_interval);
+	}
+
+	if (attach_path)
+	{
+		// Only to match the controls to the region, the simulation opens it on its own
+		SharedRegion region;
+		if (region.attach(attach_path))
+		{
+			auto preset = std::ranges::find(m_texture_sizes, (int)region.size());
+			if (preset != m_texture_sizes.end())
+				m_texture_size_preset = (int)(preset - m_texture_sizes.begin());
+			m_sampling_mode = region.sampling_mode();
+			m_sampling_strategy = SamplingStrategy::Plain;
+		}
+		else
+		{
+			SDL_Log("Error: cannot attach to shared region %s\n", attach_path);
+		}
+		m_attach_path = attach_path;
+		m_simulation.attach(m_attach_path);
+	}
+
+	if (metrics_address)
+	{
+		if (m_metrics.open(metrics_address))
+		{
+			SDL_Log("Serving metrics on %s\n", metrics_address);
+			m_simulation.set_metrics(&m_metrics);
+		}
+		else
+		{
+			SDL_Log("Error: cannot serve metrics on %s\n", metrics_address);
+		}
+	}
 }
 
 App::~App()
@@ -123,143 +178,101 @@ void App::run()
 
 	ImGuiIO &io = ImGui::GetIO();
 	(void)io;
+	profile_set_thread_name("UI");
 	// Main loop
 	bool done = false;
-	uint32_t rng_state = 0;
 	while (!done)
 	{
+		ProfileScope frame_scope("Frame");
 		// Poll and handle events (inputs, window resize, etc.)
 		// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
 		// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
 		// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
 		// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
 		// [If using SDL_MAIN_USE_CALLBACKS: call ImGui_ImplSDL3_ProcessEvent() from your SDL_AppEvent() function]
-		SDL_Event event;
-		while (SDL_PollEvent(&event))
 		{
-			ImGui_ImplSDL3_ProcessEvent(&event);
-			if (event.type == SDL_EVENT_QUIT)
-				done = true;
-			if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && event.window.windowID == SDL_GetWindowID(m_window))
-				done = true;
+			ProfileScope scope("Events");
+			SDL_Event event;
+			while (SDL_PollEvent(&event))
+			{
+				ImGui_ImplSDL3_ProcessEvent(&event);
+				if (event.type == SDL_EVENT_QUIT)
+					done = true;
+				if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && event.window.windowID == SDL_GetWindowID(m_window))
+					done = true;
+			}
 		}
 
 		// [If using SDL_MAIN_USE_CALLBACKS: all code below would likely be your SDL_AppIterate() function]
 		if (SDL_GetWindowFlags(m_window) & SDL_WINDOW_MINIMIZED)
 		{
+			m_simulation.set_resolve_enabled(false);
 			SDL_Delay(10);
 			continue;
 		}
 
 		// Start the Dear ImGui frame
+		ProfileScope layout_scope("UI layout");
 		ImGui_ImplSDLRenderer3_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
 		ImGui::NewFrame();
 
 		ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport());
 
+		// Take whatever the simulation thread published since the last frame
 		{
-			ImGui::Begin("Viewport");
+			ProfileScope scope("Snapshot");
+			m_simulation.update_snapshot();
 
-			ImVec2 content_region = ImGui::GetContentRegionAvail();
+			// The simulation pauses itself when it reaches the precision target or the sample period
+			if (m_simulation.snapshot().target_stops != m_target_stops)
+			{
+				m_target_stops = m_simulation.snapshot().target_stops;
+				m_simulation_running = false;
+			}
+		}
 
-			// write to texture - add many points per frame
-			if (m_simulation_running)
+		{
+			// Begin() returns false while the window is collapsed or docked behind another tab;
+			// the simulation then stops resolving the image until it is visible again
+			bool viewport_visible = ImGui::Begin("Viewport");
+			m_simulation.set_resolve_enabled(viewport_visible);
+
+			if (viewport_visible)
 			{
-				int texture_width = m_viewport_texture->w;
-				int texture_height = m_viewport_texture->h;
-				for (int i = 0; i < m_points_per_frame; ++i)
 				{
-					glm::vec2 coord{random_float(rng_state), random_float(rng_state)};
-					int x = (int)(coord.x * texture_width);
-					int y = (int)(coord.y * texture_height);
-
-					// Clamp to prevent out-of-bounds (only happens when coord is exactly 1.0)
-					if (x >= texture_width)
-						x = texture_width - 1;
-					if (y >= texture_height)
-						y = texture_height - 1;
-					coord = coord * 2.0f - glm::vec2(1.0f, 1.0f);
-
-					int pixel_index = y * texture_width + x;
-					m_sample_counts[pixel_index]++;
-					total_points++;
-
-					// Use configurable colors
-					uint8_t r, g, b;
-					if (glm::length(coord) <= 1.0f)
-					{
-						// Use inside circle color
-						r = (uint8_t)(m_inside_color.x * 255.0f);
-						g = (uint8_t)(m_inside_color.y * 255.0f);
-						b = (uint8_t)(m_inside_color.z * 255.0f);
-						inside_circle++;
-					}
-					else
-					{
-						// Use outside circle color
-						r = (uint8_t)(m_outside_color.x * 255.0f);
-						g = (uint8_t)(m_outside_color.y * 255.0f);
-						b = (uint8_t)(m_outside_color.z * 255.0f);
-					}
-
-					// Accumulate colors
-					m_accumulation_r[pixel_index] += r;
-					m_accumulation_g[pixel_index] += g;
-					m_accumulation_b[pixel_index] += b;
+					ProfileScope scope("Upload");
+					upload_snapshot(m_simulation.snapshot());
 				}
 
-				// Update texture based on accumulated colors divided by sample count
-				for (int y = 0; y < texture_height; ++y)
+				ImVec2 content_region = ImGui::GetContentRegionAvail();
+
+				// Scale image to fit viewport while maintaining aspect ratio and center it
+				float texture_aspect = (float)m_viewport_texture->w / (float)m_viewport_texture->h;
+				float viewport_aspect = content_region.x / content_region.y;
+
+				ImVec2 image_size;
+				if (texture_aspect > viewport_aspect)
 				{
-					for (int x = 0; x < texture_width; ++x)
-					{
-						int pixel_index = y * texture_width + x;
-						uint32_t samples = m_sample_counts[pixel_index];
-
-						if (samples == 0)
-						{
-							m_viewport_data[pixel_index] = ToColor(0, 0, 0, 255); // Black for no samples
-						}
-						else
-						{
-							// Average the accumulated colors
-							uint8_t final_r = (uint8_t)(m_accumulation_r[pixel_index] / samples);
-							uint8_t final_g = (uint8_t)(m_accumulation_g[pixel_index] / samples);
-							uint8_t final_b = (uint8_t)(m_accumulation_b[pixel_index] / samples);
-							m_viewport_data[pixel_index] = ToColor(final_r, final_g, final_b, 255);
-						}
-					}
+					// Texture is wider, fit to width
+					image_size.x = content_region.x;
+					image_size.y = content_region.x / texture_aspect;
+				}
+				else
+				{
+					// Texture is taller, fit to height
+					image_size.y = content_region.y;
+					image_size.x = content_region.y * texture_aspect;
 				}
 
-				SDL_UpdateTexture(m_viewport_texture, nullptr, m_viewport_data.data(), texture_width * 4);
-			}
-
-			// Scale image to fit viewport while maintaining aspect ratio and center it
-			float texture_aspect = (float)m_viewport_texture->w / (float)m_viewport_texture->h;
-			float viewport_aspect = content_region.x / content_region.y;
+				ImVec2 cursor_pos = ImGui::GetCursorPos();
+				ImVec2 center_pos = ImVec2(
+					cursor_pos.x + (content_region.x - image_size.x) * 0.5f,
+					cursor_pos.y + (content_region.y - image_size.y) * 0.5f);
+				ImGui::SetCursorPos(center_pos);
 
-			ImVec2 image_size;
-			if (texture_aspect > viewport_aspect)
-			{
-				// Texture is wider, fit to width
-				image_size.x = content_region.x;
-				image_size.y = content_region.x / texture_aspect;
+				ImGui::Image(m_viewport_texture, image_size);
 			}
-			else
-			{
-				// Texture is taller, fit to height
-				image_size.y = content_region.y;
-				image_size.x = content_region.y * texture_aspect;
-			}
-
-			ImVec2 cursor_pos = ImGui::GetCursorPos();
-			ImVec2 center_pos = ImVec2(
-				cursor_pos.x + (content_region.x - image_size.x) * 0.5f,
-				cursor_pos.y + (content_region.y - image_size.y) * 0.5f);
-			ImGui::SetCursorPos(center_pos);
-
-			ImGui::Image(m_viewport_texture, image_size);
 
 			ImGui::End();
 		}
@@ -270,21 +283,41 @@ void App::run()
 
 			ImGui::Begin("Properties");
 
+			// Grid size and sampling mode belong to the workers of an attached region
+			const SimulationSnapshot &snapshot = m_simulation.snapshot();
+			bool attached = !m_attach_path.empty();
+			if (attached)
+			{
+				if (snapshot.attached)
+					ImGui::Text("Viewing %s: %u workers running", m_attach_path.c_str(), snapshot.shared_workers);
+				else
+					ImGui::Text("Cannot read shared region %s", m_attach_path.c_str());
+			}
+			ImGui::BeginDisabled(attached);
+
 			// Texture size selection
 			ImGui::Text("Texture Size:");
-			if (ImGui::Combo("##TextureSize", &m_texture_size_preset, m_texture_size_names.data(), 6))
+			if (ImGui::Combo("##TextureSize", &m_texture_size_preset, m_texture_size_names.data(), m_texture_size_count))
 			{
-				// Recreate texture with new size
-				int new_size = m_texture_sizes[m_texture_size_preset];
-
-				SDL_DestroyTexture(m_viewport_texture);
-				m_viewport_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, new_size, new_size);
-
-				// Disable texture filtering to see individual pixels
-				SDL_SetTextureScaleMode(m_viewport_texture, SDL_SCALEMODE_NEAREST);
+				m_failed_texture_size = 0;
+				// Summed from the run's finer grid when there is one, so the run goes on. The
+				// texture is recreated once a snapshot with the new size arrives.
+				m_simulation.set_display_size((uint32_t)m_texture_sizes[m_texture_size_preset]);
+			}
 
-				reset(new_size * new_size);
+			// Where the points come from; a different sequence starts a new run
+			ImGui::Text("Sampling:");
+			if (ImGui::Combo("##SamplingMode", (int *)&m_sampling_mode, m_sampling_mode_names.data(), (int)m_sampling_mode_names.size()))
+			{
+				m_simulation.set_sampling_mode(m_sampling_mode);
+			}
+			// How the samples spread over the square; also starts a new run
+			ImGui::Text("Strategy:");
+			if (ImGui::Combo("##SamplingStrategy", (int *)&m_sampling_strategy, m_sampling_strategy_names.data(), (int)m_sampling_strategy_names.size()))
+			{
+				m_simulation.set_sampling_strategy(m_sampling_strategy);
 			}
+			ImGui::EndDisabled();
 
 			// Simulation controls
 			if (m_simulation_running)
@@ -292,6 +325,7 @@ void App::run()
 				if (ImGui::Button("Pause"))
 				{
 					m_simulation_running = false;
+					m_simulation.set_running(false);
 				}
 			}
 			else
@@ -299,31 +333,60 @@ void App::run()
 				if (ImGui::Button("Play"))
 				{
 					m_simulation_running = true;
+					m_simulation.set_running(true);
 				}
 			}
 
 			ImGui::SameLine();
 			if (ImGui::Button("Reset"))
 			{
-				reset((int)m_viewport_texture->w * (int)m_viewport_texture->h);
+				m_simulation.reset((uint32_t)m_texture_sizes[m_texture_size_preset]);
 			}
-			ImGui::SameLine();
-			ImGui::Text("Points per frame: ");
-			ImGui::SliderInt("##PointsPerFrame", &m_points_per_frame, 1, 1000);
-			ImGui::SameLine();
-			ImGui::InputInt("##PointsPerFrameInput", &m_points_per_frame, 1, 1000);
+
+			// Batch sizing: fixed, or sized by the simulation to take a time budget per batch
+			ImGui::Text("Batch size:");
+			bool batch_changed = ImGui::Combo("##BatchMode", (int *)&m_batch_mode, m_batch_mode_names.data(), (int)m_batch_mode_names.size());
+			switch (m_batch_mode)
+			{
+			case BatchMode::Fixed:
+				batch_changed |= ImGui::SliderInt("##PointsPerBatch", &m_points_per_batch, 1, 1 << 24, "%d", ImGuiSliderFlags_Logarithmic);
+				ImGui::SameLine();
+				batch_changed |= ImGui::InputInt("##PointsPerBatchInput", &m_points_per_batch, 1, 1000);
+				m_points_per_batch = std::max(m_points_per_batch, 1);
+				break;
+			case BatchMode::TimeBudget:
+				batch_changed |= ImGui::SliderFloat("##BatchBudget", &m_batch_budget_ms, 0.5f, 200.0f, "%.1f ms", ImGuiSliderFlags_Logarithmic);
+				break;
+			}
+			if (batch_changed)
+				apply_batch_mode();
+
+			// Results only depend on the seed, so changing the thread count keeps the run
+			ImGui::Text("Threads:");
+			if (ImGui::SliderInt("##Threads", &m_thread_count, 1, (int)WorkerPool::hardware_threads()))
+			{
+				m_simulation.set_thread_count((uint32_t)m_thread_count);
+			}
+
+			// Run until the confidence interval is narrow enough, then pause
+			ImGui::Text("Precision target:");
+			bool target_changed = ImGui::Checkbox("Stop at half-width", &m_stop_at_precision);
+			target_changed |= ImGui::InputDouble("##TargetPrecision", &m_target_precision, 0.0, 0.0, "%.3e");
+			target_changed |= ImGui::Combo("Confidence", &m_confidence_preset, m_confidence_names.data(), (int)m_confidence_names.size());
+			if (target_changed)
+				apply_target_precision();
 
 			ImGui::Separator();
 
-			// Color configuration
+			// Color configuration, applied to the existing counts without restarting the run
 			ImGui::Text("Colors:");
 			if (ImGui::ColorEdit3("Inside Circle", (float *)&m_inside_color))
 			{
-				reset((int)m_viewport_texture->w * (int)m_viewport_texture->h);
+				m_simulation.set_colors(ToSamplerColor(m_inside_color), ToSamplerColor(m_outside_color));
 			}
 			if (ImGui::ColorEdit3("Outside Circle", (float *)&m_outside_color))
 			{
-				reset((int)m_viewport_texture->w * (int)m_viewport_texture->h);
+				m_simulation.set_colors(ToSamplerColor(m_inside_color), ToSamplerColor(m_outside_color));
 			}
 
 			ImGui::Separator();
@@ -331,26 +394,66 @@ void App::run()
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
 
 			ImGui::Text("Texture size: %d x %d", (int)m_viewport_texture->w, (int)m_viewport_texture->h);
+			if (snapshot.grid_size != snapshot.size)
+				ImGui::Text("Summed from a %u x %u grid", snapshot.grid_size, snapshot.grid_size);
+
+			uint64_t total_points = snapshot.total_points;
+			uint64_t inside_circle = snapshot.inside_circle;
 
 			ImGui::Separator();
 			ImGui::Text("Monte Carlo Pi Estimation:");
 			ImGui::Text("Total points: %llu", total_points);
 			ImGui::Text("Points inside circle: %llu", inside_circle);
 			ImGui::Text("Points outside circle: %llu", total_points - inside_circle);
+			ImGui::Text("Samples/sec: %.3e", snapshot.samples_per_second);
+			ImGui::Text("Points per batch: %llu", (unsigned long long)snapshot.batch_size);
+
+			// From the run alone, no reference value needed; the estimator depends on the strategy
+			const EstimateStatistics &statistics = snapshot.statistics;
+			ImGui::Text("Standard error: %.3e", statistics.standard_error);
+			ImGui::Text("%s CI: [%.10f, %.10f] (+/- %.3e)", m_confidence_names[m_confidence_preset], statistics.lower, statistics.upper, statistics.half_width);
+			if (m_stop_at_precision)
+			{
+				uint64_t needed = snapshot.target_samples;
+				uint64_t missing = needed > total_points ? needed - total_points : 0;
+				if (snapshot.target_reached)
+					ImGui::Text("Target reached");
+				else if (snapshot.samples_per_second > 0.0)
+					ImGui::Text("ETA: %.1f s (%.3e more samples)", (double)missing / snapshot.samples_per_second, (double)missing);
+				else
+					ImGui::Text("ETA: paused (%.3e more samples)", (double)missing);
+			}
+			if (snapshot.period_reached)
+				ImGui::Text("Stopped: %s repeats after %.3e samples, pcg64 goes further", sampling_mode_name(snapshot.sampling_mode), (double)sample_period(snapshot.sampling_mode));
 
 			if (total_points > 0)
 			{
 				double ratio = (double)inside_circle / (double)total_points;
-				double estimated_pi = ratio * 4.0;
+				double estimated_pi = statistics.estimate;
 				double actual_pi = 3.141592653589793;
 				double error = abs(estimated_pi - actual_pi);
 				double error_percent = (error / actual_pi) * 100.0;
 
 				ImGui::Text("Ratio (inside/total): %.15f", ratio);
-				ImGui::Text("Formula: Pi ≈ (inside/total) × 4");
+				if (is_stratified(snapshot.sampling_strategy))
+					ImGui::Text("Formula: Pi ≈ 4 × (inside pixels + sampled edge fractions) / pixels");
+				else
+					ImGui::Text("Formula: Pi ≈ (inside/total) × 4");
 				ImGui::Text("Estimated Pi: %.15f", estimated_pi);
 				ImGui::Text("Actual Pi:    %.15f", actual_pi);
 				ImGui::Text("Error: %.15f (%.6f%%)", error, error_percent);
+
+				// Pseudo-random points have a standard error of 4 * sqrt(p (1 - p) / N) with
+				// p = pi / 4; a sequence beating it needs that many fewer samples for this error
+				double random_error = 4.0 * sqrt(0.25 * actual_pi * (1.0 - 0.25 * actual_pi) / (double)total_points);
+				ImGui::Text("Pseudo-random standard error: %.3e (%.2fx this error)", random_error, error > 0.0 ? random_error / error : 0.0);
+				if (error > 0.0)
+					ImGui::Text("Pseudo-random samples for this error: %.3e", (double)total_points * (random_error / error) * (random_error / error));
+				if (snapshot.sampling_strategy != SamplingStrategy::Plain && statistics.standard_error > 0.0)
+				{
+					double savings = (random_error / statistics.standard_error) * (random_error / statistics.standard_error);
+					ImGui::Text("Sample savings: %.3gx fewer than plain sampling for this standard error", savings);
+				}
 			}
 			else
 			{
@@ -360,35 +463,291 @@ void App::run()
 				ImGui::Text("Actual Pi:    3.141592653589793");
 				ImGui::Text("Error: N/A");
 			}
+
+			ImGui::Separator();
+			draw_convergence();
+			draw_frame_export();
+			draw_checkpoint();
+			draw_profiler();
 			ImGui::End();
 		}
 
 		// Rendering
 		ImGui::Render();
-		SDL_SetRenderScale(m_renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
-		SDL_SetRenderDrawColorFloat(m_renderer, m_clear_color.x, m_clear_color.y, m_clear_color.z, m_clear_color.w);
-		SDL_RenderClear(m_renderer);
-		ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), m_renderer);
-		SDL_RenderPresent(m_renderer);
+		layout_scope.stop();
+		{
+			ProfileScope scope("Render");
+			SDL_SetRenderScale(m_renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
+			SDL_SetRenderDrawColorFloat(m_renderer, m_clear_color.x, m_clear_color.y, m_clear_color.z, m_clear_color.w);
+			SDL_RenderClear(m_renderer);
+			ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), m_renderer);
+		}
+		{
+			ProfileScope scope("Present");
+			SDL_RenderPresent(m_renderer);
+		}
+	}
+}
+
+void App::apply_batch_mode()
+{
+	switch (m_batch_mode)
+	{
+	case BatchMode::Fixed:
+		m_simulation.set_batch_size((uint64_t)m_points_per_batch);
+		m_simulation.set_batch_budget(0.0);
+		break;
+	case BatchMode::TimeBudget:
+		m_simulation.set_batch_budget(m_batch_budget_ms / 1000.0);
+		break;
+	}
+}
+
+void App::apply_target_precision()
+{
+	m_target_precision = std::max(m_target_precision, 1.0e-12);
+	double confidence = m_confidence_levels[m_confidence_preset];
+	m_confidence_z = confidence_z(confidence);
+	m_simulation.set_target_precision(m_stop_at_precision ? m_target_precision : 0.0, confidence);
+}
+
+void App::draw_checkpoint()
+{
+	if (!ImGui::CollapsingHeader("Checkpoint"))
+		return;
+
+	if (m_checkpoint_path.empty())
+	{
+		ImGui::TextDisabled("Start with --checkpoint <file> to save and resume runs");
+		return;
 	}
+
+	const SimulationSnapshot &snapshot = m_simulation.snapshot();
+	ImGui::Text("File: %s", m_checkpoint_path.c_str());
+	ImGui::Text("Saved points: %llu", (unsigned long long)snapshot.checkpoint_points);
+	if (snapshot.checkpoint_failures > 0)
+		ImGui::Text("Failed writes: %llu", (unsigned long long)snapshot.checkpoint_failures);
+	if (ImGui::SliderFloat("Interval", &m_checkpoint_interval, 5.0f, 3600.0f, "%.0f s", ImGuiSliderFlags_Logarithmic))
+		m_simulation.set_checkpoint(m_checkpoint_path, m_checkpoint_interval);
+	if (ImGui::Button("Save now"))
+		m_simulation.checkpoint_now();
+}
+
+void App::draw_frame_export()
+{
+	if (!ImGui::CollapsingHeader("Frame export"))
+		return;
+
+	// Settings apply when recording starts
+	ImGui::BeginDisabled(m_frame_export);
+	ImGui::InputText("Prefix", m_frame_prefix, sizeof(m_frame_prefix));
+	ImGui::Combo("Format", (int *)&m_frame_format, m_frame_format_names.data(), (int)m_frame_format_names.size());
+	ImGui::InputDouble("Every", &m_frame_interval, 0.0, 0.0, "%.3e samples");
+	m_frame_interval = std::clamp(m_frame_interval, 1.0, 1.0e18);
+	ImGui::EndDisabled();
+
+	if (ImGui::Checkbox("Record", &m_frame_export))
+	{
+		if (m_frame_export && m_frame_prefix[0] != '\0')
+			m_simulation.set_frame_export(m_frame_prefix, m_frame_format, (uint64_t)m_frame_interval);
+		else
+			m_simulation.set_frame_export("", m_frame_format, 0);
+		m_frame_export &= m_frame_prefix[0] != '\0';
+	}
+
+	const SimulationSnapshot &snapshot = m_simulation.snapshot();
+	ImGui::Text("Frames written: %llu", (unsigned long long)snapshot.frames_written);
+	if (snapshot.frames_dropped > 0)
+		ImGui::Text("Dropped, writer behind: %llu", (unsigned long long)snapshot.frames_dropped);
+	if (snapshot.frame_failures > 0)
+		ImGui::Text("Failed writes: %llu", (unsigned long long)snapshot.frame_failures);
+}
+
+void App::draw_convergence()
+{
+	if (!ImGui::CollapsingHeader("Convergence"))
+		return;
+
+	const ConvergenceHistory &history = m_simulation.history();
+	uint64_t version = history.version();
+	if (version != m_history_version)
+	{
+		m_history_version = version;
+		history.read(m_history_points);
+		m_history_estimates.clear();
+		m_history_errors.clear();
+		m_history_standard_errors.clear();
+		for (const ConvergenceHistory::Point &point : m_history_points)
+		{
+			double error = abs(point.estimate - 3.141592653589793);
+			m_history_estimates.push_back((float)point.estimate);
+			m_history_errors.push_back((float)log10(std::max(error, 1.0e-16)));
+			m_history_standard_errors.push_back((float)log10(std::max(point.standard_error, 1.0e-16)));
+		}
+	}
+
+	if (ImGui::Button("Export CSV"))
+	{
+		char path[64];
+		snprintf(path, sizeof(path), "convergence-%llu.csv", (unsigned long long)SDL_GetTicks());
+		if (history.write_csv(path))
+			SDL_Log("Wrote %s\n", path);
+		else
+			SDL_Log("Error: could not write %s\n", path);
+	}
+	if (m_history_points.empty())
+	{
+		ImGui::TextDisabled("No samples yet");
+		return;
+	}
+
+	// One point per bucket, so the x axis is log10 of the sample count
+	ImGui::Text("Samples: 10^%.1f to 10^%.1f, %zu points", log10((double)m_history_points.front().total_points),
+		log10((double)m_history_points.back().total_points), m_history_points.size());
+
+	int count = (int)m_history_points.size();
+	char overlay[96];
+	snprintf(overlay, sizeof(overlay), "estimate %.10f", m_history_estimates.back());
+	ImGui::PlotLines("##Estimate", m_history_estimates.data(), count, 0, overlay, FLT_MAX, FLT_MAX, ImVec2(0, 60.0f));
+
+	// Same scale for both, the error should stay around the standard error
+	float low = *std::min_element(m_history_standard_errors.begin(), m_history_standard_errors.end());
+	float high = *std::max_element(m_history_standard_errors.begin(), m_history_standard_errors.end());
+	low = std::min(low, *std::min_element(m_history_errors.begin(), m_history_errors.end()));
+	high = std::max(high, *std::max_element(m_history_errors.begin(), m_history_errors.end()));
+	snprintf(overlay, sizeof(overlay), "log10 |error| %.2f", m_history_errors.back());
+	ImGui::PlotLines("##Error", m_history_errors.data(), count, 0, overlay, low, high, ImVec2(0, 60.0f));
+	snprintf(overlay, sizeof(overlay), "log10 standard error %.2f", m_history_standard_errors.back());
+	ImGui::PlotLines("##StandardError", m_history_standard_errors.data(), count, 0, overlay, low, high, ImVec2(0, 60.0f));
 }
 
-void App::reset(uint32_t pixel_count)
+void App::draw_profiler()
 {
-	total_points = 0;
-	inside_circle = 0;
-	m_viewport_data.resize(pixel_count);
-	m_accumulation_r.resize(pixel_count);
-	m_accumulation_g.resize(pixel_count);
-	m_accumulation_b.resize(pixel_count);
-	m_sample_counts.resize(pixel_count);
-
-	std::ranges::fill(m_accumulation_r, 0);
-	std::ranges::fill(m_accumulation_g, 0);
-	std::ranges::fill(m_accumulation_b, 0);
-	std::ranges::fill(m_sample_counts, 0);
-	std::fill(m_viewport_data.begin(), m_viewport_data.end(), ToColor(0, 0, 0, 255));
-	SDL_UpdateTexture(m_viewport_texture, nullptr, m_viewport_data.data(), (uint32_t)m_viewport_texture->w * 4);
+	if (!ImGui::CollapsingHeader("Profiler"))
+		return;
+
+	if (ImGui::Checkbox("Record", &m_profiling))
+		profile_set_enabled(m_profiling);
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace"))
+	{
+		// Chrome trace event JSON, opens in chrome://tracing or ui.perfetto.dev
+		char path[64];
+		snprintf(path, sizeof(path), "trace-%llu.json", (unsigned long long)SDL_GetTicks());
+		if (write_chrome_trace(path))
+			SDL_Log("Wrote %s\n", path);
+		else
+			SDL_Log("Error: could not write %s\n", path);
+	}
+
+	m_profile_history.update();
+	for (const ProfileHistory::Stage &stage : m_profile_history.stages())
+	{
+		char overlay[96];
+		snprintf(overlay, sizeof(overlay), "p50 %.3f  p95 %.3f  p99 %.3f ms", stage.percentile(0.5f), stage.percentile(0.95f), stage.percentile(0.99f));
+
+		// Oldest first once the ring has wrapped
+		int offset = stage.count == ProfileHistory::s_history_size ? (int)stage.next : 0;
+		ImGui::PushID(stage.name);
+		ImGui::Text("%s", stage.name);
+		ImGui::PlotLines("##History", stage.milliseconds.data(), (int)stage.count, offset, overlay, 0.0f, FLT_MAX, ImVec2(0, 40.0f));
+		ImGui::PopID();
+	}
+}
+
+bool App::create_viewport_texture(int size)
+{
+	// The current texture stays when the renderer cannot make one this size
+	SDL_Texture *texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, size, size);
+	if (texture == nullptr)
+	{
+		SDL_Log("Error: SDL_CreateTexture(%d x %d): %s\n", size, size, SDL_GetError());
+		return false;
+	}
+	if (m_viewport_texture)
+		SDL_DestroyTexture(m_viewport_texture);
+	m_viewport_texture = texture;
+
+	// Disable texture filtering to see individual pixels
+	SDL_SetTextureScaleMode(m_viewport_texture, SDL_SCALEMODE_NEAREST);
+
+	void *pixels = nullptr;
+	int pitch = 0;
+	if (SDL_LockTexture(m_viewport_texture, nullptr, &pixels, &pitch))
+	{
+		for (int y = 0; y < size; ++y)
+		{
+			uint32_t *row = (uint32_t *)((uint8_t *)pixels + (size_t)y * pitch);
+			std::fill(row, row + size, ToColor(0, 0, 0, 255));
+		}
+		SDL_UnlockTexture(m_viewport_texture);
+	}
+	m_uploaded_version = 0;
+	return true;
+}
+
+void App::upload_snapshot(const SimulationSnapshot &snapshot)
+{
+	if (snapshot.pixels.empty() || snapshot.pixels_version <= m_uploaded_version)
+		return;
+
+	if (snapshot.size != (uint32_t)m_viewport_texture->w)
+	{
+		// Already falling back, until the simulation publishes the previous size again
+		if (snapshot.size == m_failed_texture_size)
+			return;
+		if (!create_viewport_texture((int)snapshot.size))
+		{
+			// Back to the size of the texture there is
+			m_failed_texture_size = snapshot.size;
+			auto preset = std::ranges::find(m_texture_sizes, m_viewport_texture->w);
+			if (preset != m_texture_sizes.end())
+				m_texture_size_preset = (int)(preset - m_texture_sizes.begin());
+			m_simulation.set_display_size((uint32_t)m_viewport_texture->w);
+			return;
+		}
+	}
+
+	// Copy each horizontal run of changed tiles straight into the locked streaming texture.
+	// Locked memory is write-only and may not hold the old contents, so every pixel of the
+	// locked rect is written.
+	uint32_t size = snapshot.size;
+	uint32_t tiles_per_row = snapshot.tiles_per_row;
+	for (uint32_t tile_y = 0; tile_y < tiles_per_row; ++tile_y)
+	{
+		uint32_t tile_x = 0;
+		while (tile_x < tiles_per_row)
+		{
+			if (snapshot.tile_versions[tile_y * tiles_per_row + tile_x] <= m_uploaded_version)
+			{
+				tile_x++;
+				continue;
+			}
+			uint32_t run_end = tile_x + 1;
+			while (run_end < tiles_per_row && snapshot.tile_versions[tile_y * tiles_per_row + run_end] > m_uploaded_version)
+				run_end++;
+
+			SDL_Rect rect;
+			rect.x = (int)(tile_x * Sampler::s_tile_size);
+			rect.y = (int)(tile_y * Sampler::s_tile_size);
+			rect.w = (int)std::min(size, run_end * Sampler::s_tile_size) - rect.x;
+			rect.h = (int)std::min(size, (tile_y + 1) * Sampler::s_tile_size) - rect.y;
+
+			void *pixels = nullptr;
+			int pitch = 0;
+			if (SDL_LockTexture(m_viewport_texture, &rect, &pixels, &pitch))
+			{
+				for (int row = 0; row < rect.h; ++row)
+				{
+					const uint32_t *source = snapshot.pixels.data() + (size_t)(rect.y + row) * size + rect.x;
+					memcpy((uint8_t *)pixels + (size_t)row * pitch, source, (size_t)rect.w * 4);
+				}
+				SDL_UnlockTexture(m_viewport_texture);
+			}
+			tile_x = run_end;
+		}
+	}
+	m_uploaded_version = snapshot.pixels_version;
 }
 
 void SetDarkThemeColors()
@@ -3,7 +3,11 @@
 #include <imgui.h>
 #include <glm/vec2.hpp>
 
+#include "engine/Profiler.h"
+#include "engine/Simulation.h"
+
 #include <cstdint>
+#include <string>
 #include <vector>
 #include <array>
 
@@ -14,13 +18,20 @@ struct SDL_Texture;
 class App
 {
 public:
-	App();
+	explicit App(const char *checkpoint_path = nullptr, const char *attach_path = nullptr, const char *metrics_address = nullptr);
 	~App();
 
 	void run();
 
 private:
-	void reset(uint32_t pixel_count);
+	bool create_viewport_texture(int size);
+	void upload_snapshot(const SimulationSnapshot &snapshot);
+	void apply_batch_mode();
+	void apply_target_precision();
+	void draw_profiler();
+	void draw_checkpoint();
+	void draw_convergence();
+	void draw_frame_export();
 
 private:
 	static App *s_Instance;
@@ -32,23 +43,69 @@ private:
 	uint32_t m_width = 2560;
 	uint32_t m_height = 1440;
 
-	std::vector<uint32_t> m_viewport_data;
-	std::vector<uint32_t> m_accumulation_r;
-	std::vector<uint32_t> m_accumulation_g;
-	std::vector<uint32_t> m_accumulation_b;
-	std::vector<uint32_t> m_sample_counts;
 	SDL_Texture *m_viewport_texture = nullptr;
+	uint64_t m_uploaded_version = 0; // Sampler version of the tiles last copied into the texture
 
 	int m_texture_size_preset = 4;
-	static constexpr std::array<int, 6> m_texture_sizes = {8, 16, 32, 64, 512, 1024};
-	static constexpr std::array<const char *, 6> m_texture_size_names = {"8x8", "16x16", "32x32", "64x64", "512x512", "1024x1024"};
+	int m_texture_size_count = (int)m_texture_sizes.size(); // Presets up to the renderer's maximum texture size
+	uint32_t m_failed_texture_size = 0; // Display size the texture could not be created at, if any
+	static constexpr std::array<int, 9> m_texture_sizes = {8, 16, 32, 64, 512, 1024, 2048, 4096, 8192};
+	static constexpr std::array<const char *, 9> m_texture_size_names = {"8x8", "16x16", "32x32", "64x64", "512x512", "1024x1024", "2048x2048", "4096x4096", "8192x8192"};
 
 	ImVec4 m_inside_color = ImVec4(120.0f / 255.0f, 160.0f / 255.0f, 255.0f / 255.0f, 1.0f);
 	ImVec4 m_outside_color = ImVec4(255.0f / 255.0f, 140.0f / 255.0f, 140.0f / 255.0f, 1.0f);
 
+	// Declared first so it outlives the simulation that publishes to it
+	MetricsServer m_metrics;
+
+	// Samples on its own thread; the UI only reads the snapshots it publishes
+	Simulation m_simulation;
+
 	bool m_simulation_running = true;
-	int m_points_per_frame = 10;
 
-	uint64_t total_points = 0;
-	uint64_t inside_circle = 0;
+	static constexpr std::array<const char *, 11> m_sampling_mode_names = {"Pseudo-random (float)", "Sobol", "Sobol (Owen scrambled)", "Halton", "Halton (shifted)", "R2", "R2 (shifted)", "PCG64", "xoshiro256+", "Philox4x32-10", "Pseudo-random"};
+	SamplingMode m_sampling_mode = SamplingMode::Pcg64;
+	static constexpr std::array<const char *, 5> m_sampling_strategy_names = {"Plain", "Quadrant", "Antithetic pairs", "Stratified", "Boundary band"};
+	SamplingStrategy m_sampling_strategy = SamplingStrategy::Plain;
+
+	enum class BatchMode
+	{
+		Fixed,
+		TimeBudget,
+	};
+	static constexpr std::array<const char *, 2> m_batch_mode_names = {"Fixed", "Time budget"};
+	BatchMode m_batch_mode = BatchMode::TimeBudget;
+	int m_points_per_batch = 1 << 16;
+	float m_batch_budget_ms = 16.0f;
+	int m_thread_count = 1;
+
+	bool m_stop_at_precision = false;
+	double m_target_precision = 1.0e-4; // Confidence interval half-width to stop at
+	int m_confidence_preset = 1;
+	static constexpr std::array<double, 4> m_confidence_levels = {0.90, 0.95, 0.99, 0.999};
+	static constexpr std::array<const char *, 4> m_confidence_names = {"90%", "95%", "99%", "99.9%"};
+	double m_confidence_z = 1.96;
+	uint64_t m_target_stops = 0; // Of the last snapshot, a new stop pauses the UI too
+
+	std::string m_checkpoint_path; // Empty when checkpoints are off
+	std::string m_attach_path; // Shared region of worker processes being viewed, if any
+	float m_checkpoint_interval = 60.0f;
+
+	// Numbered images of the run, written in the background every m_frame_interval samples
+	bool m_frame_export = false;
+	char m_frame_prefix[256] = "frame-";
+	ImageFormat m_frame_format = ImageFormat::Png;
+	static constexpr std::array<const char *, 2> m_frame_format_names = {"PPM", "PNG"};
+	double m_frame_interval = 1.0e7;
+
+	// Copy of the simulation's convergence history, refreshed when its version changes
+	uint64_t m_history_version = UINT64_MAX;
+	std::vector<ConvergenceHistory::Point> m_history_points;
+	std::vector<float> m_history_estimates;
+	std::vector<float> m_history_errors; // log10 |estimate - pi|
+	std::vector<float> m_history_standard_errors; // log10
+
+	// Frame phases of this thread and sampling stages of the simulation threads
+	ProfileHistory m_profile_history;
+	bool m_profiling = true;
 };
@@ -0,0 +1,396 @@
+#include "engine/EstimatorBatch.h"
+#include "engine/Random.h"
+#include "engine/Sampler.h"
+#include "engine/Sequence.h"
+#include "engine/SimdKernel.h"
+#include "engine/WorkerPool.h"
+
+#if defined(PI_BENCH_SDL)
+#include <SDL3/SDL.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Same presets as App::m_texture_sizes
+static constexpr std::array<uint32_t, 9> s_grid_sizes = {8, 16, 32, 64, 512, 1024, 2048, 4096, 8192};
+
+struct BenchOptions
+{
+	double min_time = 0.25;
+	uint32_t repetitions = 5;
+	uint32_t max_size = 8192;
+	std::vector<uint32_t> thread_counts;
+};
+
+static void PrintUsage(const char *program)
+{
+	printf("Usage: %s [options]\n", program);
+	printf("Measures each stage separately and prints the results as JSON.\n");
+	printf("  -o, --output <file>       Write the JSON to a file instead of stdout\n");
+	printf("      --min-time <seconds>  Minimum duration of one repetition (default 0.25)\n");
+	printf("      --repetitions <n>     Repetitions per measurement, the median is reported (default 5)\n");
+	printf("      --max-size <pixels>   Skip grid presets larger than this (default 8192)\n");
+	printf("  -t, --threads <count>     Sampling threads (default: 1 and all hardware threads)\n");
+	printf("      --simd <level>        Kernel: scalar, avx2 or avx512 (default: widest supported)\n");
+	printf("  -h, --help                Show this message\n");
+}
+
+static double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Calls `body` until min_time has passed, per repetition, and returns the median rate
+// in items per second. `body` runs one step and returns the number of items it did.
+template <typename Body>
+static double MeasureRate(const BenchOptions &options, Body &&body)
+{
+	std::vector<double> rates;
+	for (uint32_t repetition = 0; repetition < options.repetitions; ++repetition)
+	{
+		uint64_t items = 0;
+		double start = Now();
+		double elapsed = 0.0;
+		do
+		{
+			items += body();
+			elapsed = Now() - start;
+		} while (elapsed < options.min_time);
+		rates.push_back((double)items / elapsed);
+	}
+	std::sort(rates.begin(), rates.end());
+	return rates[rates.size() / 2];
+}
+
+class JsonWriter
+{
+public:
+	explicit JsonWriter(FILE *file)
+		: m_file(file)
+	{
+	}
+
+	void begin_result(const char *stage)
+	{
+		fprintf(m_file, "%s\n    {\"stage\": \"%s\"", m_results++ ? "," : "", stage);
+	}
+
+	void field(const char *name, uint64_t value)
+	{
+		fprintf(m_file, ", \"%s\": %llu", name, (unsigned long long)value);
+	}
+
+	void field(const char *name, double value)
+	{
+		fprintf(m_file, ", \"%s\": %.6e", name, value);
+	}
+
+	void field(const char *name, const char *value)
+	{
+		fprintf(m_file, ", \"%s\": \"%s\"", name, value);
+	}
+
+	void end_result()
+	{
+		fprintf(m_file, "}");
+		fflush(m_file);
+	}
+
+private:
+	FILE *m_file;
+	uint32_t m_results = 0;
+};
+
+static void BenchRandom(const BenchOptions &options, JsonWriter &json)
+{
+	fprintf(stderr, "random_float\n");
+	uint32_t state = 1;
+	float sum = 0.0f;
+	double rate = MeasureRate(options, [&] {
+		constexpr uint32_t count = 1 << 20;
+		for (uint32_t i = 0; i < count; ++i)
+			sum += random_float(state);
+		return (uint64_t)count;
+	});
+
+	// The sum keeps the loop from being optimized away
+	json.begin_result("random_float");
+	json.field("floats_per_second", rate);
+	json.field("checksum", (double)sum);
+	json.end_result();
+}
+
+static void BenchSample(const BenchOptions &options, JsonWriter &json, uint32_t size, uint32_t thread_count)
+{
+	fprintf(stderr, "sample %ux%u, %u threads\n", size, size, thread_count);
+	Sampler sampler(size, thread_count);
+	// The SIMD hash, so the rate is the scatter's rather than the generator's
+	sampler.set_sampling_mode(SamplingMode::RandomExact);
+	uint64_t batch = std::max<uint64_t>(1 << 20, (uint64_t)thread_count << 18);
+	sampler.sample(batch); // Warm up the pool and fault in the grid
+	double rate = MeasureRate(options, [&] {
+		sampler.sample(batch);
+		return batch;
+	});
+
+	json.begin_result("sample");
+	json.field("size", (uint64_t)size);
+	json.field("threads", (uint64_t)thread_count);
+	json.field("batch", batch);
+	json.field("samples_per_second", rate);
+	json.end_result();
+}
+
+// One thread, so the rate is the generator's and not the machine's
+static void BenchSamplingMode(const BenchOptions &options, JsonWriter &json, SamplingMode mode, uint32_t size)
+{
+	fprintf(stderr, "sampling %s, %ux%u\n", sampling_mode_name(mode), size, size);
+	Sampler sampler(size, 1);
+	sampler.set_sampling_mode(mode);
+	constexpr uint64_t batch = 1 << 20;
+	sampler.sample(batch);
+	double rate = MeasureRate(options, [&] {
+		sampler.sample(batch);
+		return batch;
+	});
+
+	json.begin_result("sampling_mode");
+	json.field("mode", sampling_mode_name(mode));
+	json.field("size", (uint64_t)size);
+	json.field("samples_per_second", rate);
+	json.end_result();
+}
+
+// Throughput alone misses what a strategy is for; variance * samples is the variance of
+// the estimate at one sample, and dividing by the rate gives it per second of sampling
+static void BenchStrategy(const BenchOptions &options, JsonWriter &json, SamplingStrategy strategy, uint32_t size)
+{
+	fprintf(stderr, "strategy %s, %ux%u\n", sampling_strategy_name(strategy), size, size);
+	Sampler sampler(size, 1);
+	sampler.set_sampling_mode(SamplingMode::RandomExact);
+	sampler.set_sampling_strategy(strategy);
+	constexpr uint64_t batch = 1 << 20;
+	sampler.sample(batch);
+	double rate = MeasureRate(options, [&] {
+		sampler.sample(batch);
+		return batch;
+	});
+	double variance_per_sample = sampler.statistics(1.0).variance * (double)sampler.total_points();
+
+	json.begin_result("sampling_strategy");
+	json.field("strategy", sampling_strategy_name(strategy));
+	json.field("size", (uint64_t)size);
+	json.field("samples_per_second", rate);
+	json.field("variance_per_sample", variance_per_sample);
+	json.field("variance_second", variance_per_sample / rate);
+	json.end_result();
+}
+
+static void BenchEstimators(const BenchOptions &options, JsonWriter &json, uint32_t estimators)
+{
+	fprintf(stderr, "estimators %u\n", estimators);
+	EstimatorBatch batch(estimators, 0, SamplingMode::RandomExact);
+	constexpr uint64_t batch_samples = 1 << 16;
+	double rate = MeasureRate(options, [&] {
+		batch.sample(batch_samples);
+		return batch_samples * estimators;
+	});
+
+	json.begin_result("estimators");
+	json.field("estimators", (uint64_t)estimators);
+	json.field("samples_per_second", rate);
+	json.end_result();
+}
+
+static void BenchResolve(const BenchOptions &options, JsonWriter &json, uint32_t size)
+{
+	fprintf(stderr, "resolve %ux%u\n", size, size);
+	Sampler sampler(size);
+	sampler.sample((uint64_t)size * size * 4);
+	std::vector<uint32_t> pixels((size_t)size * size);
+	double rate = MeasureRate(options, [&] {
+		sampler.resolve(pixels.data());
+		return (uint64_t)pixels.size();
+	});
+
+	json.begin_result("resolve");
+	json.field("size", (uint64_t)size);
+	json.field("pixels_per_second", rate);
+	json.field("frame_ms", 1000.0 * (double)pixels.size() / rate);
+	json.end_result();
+}
+
+#if defined(PI_BENCH_SDL)
+static void BenchUpload(const BenchOptions &options, JsonWriter &json, SDL_Renderer *renderer, uint32_t size)
+{
+	fprintf(stderr, "upload %ux%u\n", size, size);
+	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, (int)size, (int)size);
+	if (!texture)
+	{
+		fprintf(stderr, "Error: SDL_CreateTexture(%u): %s\n", size, SDL_GetError());
+		return;
+	}
+
+	std::vector<uint32_t> pixels((size_t)size * size, ToColor(120, 160, 255, 255));
+	double rate = MeasureRate(options, [&] {
+		SDL_UpdateTexture(texture, nullptr, pixels.data(), (int)(size * sizeof(uint32_t)));
+		return (uint64_t)1;
+	});
+	SDL_DestroyTexture(texture);
+
+	json.begin_result("upload");
+	json.field("size", (uint64_t)size);
+	json.field("frame_ms", 1000.0 / rate);
+	json.field("bytes_per_second", rate * (double)pixels.size() * sizeof(uint32_t));
+	json.end_result();
+}
+#endif
+
+static bool ParseNumber(const char *text, double &value)
+{
+	char *end = nullptr;
+	value = strtod(text, &end);
+	return end != text && *end == '\0' && value > 0.0;
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options;
+	const char *output = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+		double value = 0.0;
+		if ((!strcmp(arg, "-o") || !strcmp(arg, "--output")) && has_value)
+		{
+			output = argv[++i];
+		}
+		else if (!strcmp(arg, "--min-time") && has_value && ParseNumber(argv[i + 1], value))
+		{
+			options.min_time = value;
+			++i;
+		}
+		else if (!strcmp(arg, "--repetitions") && has_value && ParseNumber(argv[i + 1], value))
+		{
+			options.repetitions = std::max<uint32_t>(1, (uint32_t)value);
+			++i;
+		}
+		else if (!strcmp(arg, "--max-size") && has_value && ParseNumber(argv[i + 1], value))
+		{
+			options.max_size = (uint32_t)value;
+			++i;
+		}
+		else if ((!strcmp(arg, "-t") || !strcmp(arg, "--threads")) && has_value && ParseNumber(argv[i + 1], value) && value <= 4096)
+		{
+			options.thread_counts = {(uint32_t)value};
+			++i;
+		}
+		else if (!strcmp(arg, "--simd") && has_value)
+		{
+			const char *name = argv[++i];
+			SimdLevel level = SimdLevel::Scalar;
+			if (!strcmp(name, "avx2"))
+				level = SimdLevel::Avx2;
+			else if (!strcmp(name, "avx512"))
+				level = SimdLevel::Avx512;
+			else if (strcmp(name, "scalar"))
+			{
+				fprintf(stderr, "Error: unknown SIMD level '%s'\n", name);
+				return 1;
+			}
+			set_simd_level(level);
+		}
+		else if (!strcmp(arg, "-h") || !strcmp(arg, "--help"))
+		{
+			PrintUsage(argv[0]);
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, "Error: invalid argument '%s'\n", arg);
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (options.thread_counts.empty())
+	{
+		options.thread_counts = {1};
+		if (WorkerPool::hardware_threads() > 1)
+			options.thread_counts.push_back(WorkerPool::hardware_threads());
+	}
+
+	FILE *file = output ? fopen(output, "w") : stdout;
+	if (!file)
+	{
+		fprintf(stderr, "Error: cannot open '%s'\n", output);
+		return 1;
+	}
+
+	fprintf(file, "{\n  \"simd\": \"%s\",\n  \"hardware_threads\": %u,\n  \"min_time\": %.3f,\n  \"repetitions\": %u,\n  \"results\": [",
+		simd_level_name(simd_level()), WorkerPool::hardware_threads(), options.min_time, options.repetitions);
+
+	JsonWriter json(file);
+	BenchRandom(options, json);
+	for (uint32_t thread_count : options.thread_counts)
+	{
+		BenchSample(options, json, 0, thread_count);
+		for (uint32_t size : s_grid_sizes)
+		{
+			if (size <= options.max_size)
+				BenchSample(options, json, size, thread_count);
+		}
+	}
+	for (uint32_t mode = 0; mode < (uint32_t)SamplingMode::Count; ++mode)
+	{
+		BenchSamplingMode(options, json, (SamplingMode)mode, 0);
+		if (options.max_size >= 512)
+			BenchSamplingMode(options, json, (SamplingMode)mode, 512);
+	}
+	for (uint32_t strategy = 0; strategy < (uint32_t)SamplingStrategy::Count; ++strategy)
+	{
+		if (options.max_size >= 512)
+			BenchStrategy(options, json, (SamplingStrategy)strategy, 512);
+	}
+	BenchEstimators(options, json, 64);
+	for (uint32_t size : s_grid_sizes)
+	{
+		if (size <= options.max_size)
+			BenchResolve(options, json, size);
+	}
+
+#if defined(PI_BENCH_SDL)
+	// A software renderer on an offscreen surface needs no window or video driver
+	SDL_Surface *surface = SDL_CreateSurface(1, 1, SDL_PIXELFORMAT_RGBA8888);
+	SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+	if (renderer)
+	{
+		for (uint32_t size : s_grid_sizes)
+		{
+			if (size <= options.max_size)
+				BenchUpload(options, json, renderer, size);
+		}
+		SDL_DestroyRenderer(renderer);
+	}
+	else
+	{
+		fprintf(stderr, "Error: SDL_CreateSoftwareRenderer(): %s\n", SDL_GetError());
+	}
+	if (surface)
+		SDL_DestroySurface(surface);
+#endif
+
+	fprintf(file, "\n  ]\n}\n");
+	if (file != stdout)
+		fclose(file);
+	return 0;
+}
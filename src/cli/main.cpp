@@ -0,0 +1,597 @@
+#include "engine/Checkpoint.h"
+#include "engine/EstimatorBatch.h"
+#include "engine/FrameExporter.h"
+#include "engine/MetricsServer.h"
+#include "engine/Profiler.h"
+#include "engine/Sampler.h"
+#include "engine/SharedRegion.h"
+#include "engine/SimdKernel.h"
+#include "engine/Statistics.h"
+#include "engine/Strategy.h"
+#include "engine/WorkerPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+static void PrintUsage(const char *program)
+{
+	printf("Usage: %s [options]\n", program);
+	printf("  -n, --samples <count>  Number of points to throw (default 100000000, accepts 1e9);\n");
+	printf("                         a resumed run only throws the ones still missing\n");
+	printf("      --epsilon <value>  Stop once the confidence interval's half-width is at most this;\n");
+	printf("                         -n then only caps the run (default: no cap)\n");
+	printf("      --confidence <level>  Confidence of the interval, e.g. 0.99 (default 0.95)\n");
+	printf("  -s, --size <pixels>    Accumulation grid size, 0 to only count (default 512)\n");
+	printf("  -t, --threads <count>  Sampling threads (default: all hardware threads)\n");
+	printf("      --seed <value>     RNG seed; results depend only on the seed (default 0)\n");
+	printf("      --sampling <mode>  Point sequence: pcg64, xoshiro256+, philox, random-exact, random,\n");
+	printf("                         sobol, sobol-owen, halton, halton-shifted, r2 or r2-shifted\n");
+	printf("                         (default pcg64); random-exact and random are faster but repeat\n");
+	printf("                         after 2^31 samples and stop there\n");
+	printf("      --strategy <name>  Spread of the samples: plain, quadrant, antithetic, stratified or\n");
+	printf("                         band (default plain); all but plain need an even --size, and\n");
+	printf("                         stratified and band a grid\n");
+	printf("      --simd <level>     Kernel: scalar, avx2 or avx512 (default: widest supported)\n");
+	printf("      --trace <file>     Write a Chrome/Perfetto trace of the run\n");
+	printf("      --checkpoint <file>  Resume from the file if it exists, save to it periodically and at the end\n");
+	printf("      --checkpoint-interval <seconds>  Time between checkpoints (default 60)\n");
+	printf("      --shared <file>    Worker mode: add this process's samples to the shared region in the\n");
+	printf("                         file (created if missing); -n counts this process's samples.\n");
+	printf("                         With random or random-exact a slot holds 2^31 / --slots samples\n");
+	printf("      --slots <count>    Worker slots of a region this process creates (default 64)\n");
+	printf("      --publish-interval <seconds>  Time between publishes to the region (default 0.5)\n");
+	printf("      --estimators <count>  Run this many independent estimates at once, seeded seed,\n");
+	printf("                         seed + 1, ..., with -n points each, and report their spread;\n");
+	printf("                         pcg64 or philox (fastest), or random-exact and random, which\n");
+	printf("                         split the seed's stream into slices of 2^31 / count points\n");
+	printf("      --frames <prefix>  Write the grid as <prefix>000001.png, <prefix>000002.png, ... every\n");
+	printf("                         --frame-interval samples, encoded on background threads\n");
+	printf("      --frame-interval <count>  Samples between frames (default 1e7)\n");
+	printf("      --frame-format <format>  ppm or png (default png)\n");
+	printf("      --metrics <address>  Serve the run's metrics for Prometheus at <port>, <host>:<port>\n");
+	printf("                         or unix:<path>\n");
+	printf("  -h, --help             Show this message\n");
+}
+
+static bool ParseCount(const char *text, uint64_t &value)
+{
+	char *end = nullptr;
+	double parsed = strtod(text, &end);
+	if (end == text || *end != '\0' || parsed < 1.0 || parsed > 1.8e19)
+		return false;
+	value = (uint64_t)parsed;
+	return true;
+}
+
+// Variance study: the spread of many independent estimates against the standard error
+// each one should have
+static void RunEstimators(uint32_t estimators, uint32_t seed, SamplingMode mode, uint64_t samples, uint32_t threads)
+{
+	EstimatorBatch batch(estimators, seed, mode, threads);
+	auto start = std::chrono::steady_clock::now();
+	batch.sample(samples);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	EstimatorSpread spread = estimator_spread(batch.inside_circle().data(), estimators, samples);
+	double actual_pi = 3.141592653589793;
+	if (batch.slice_samples() != UINT64_MAX)
+		printf("Estimators:      %u (disjoint slices of seed %u, %llu samples each)\n", estimators, seed, (unsigned long long)batch.slice_samples());
+	else
+		printf("Estimators:      %u (seeds %u to %u)\n", estimators, seed, seed + estimators - 1);
+	printf("Threads:         %u\n", batch.thread_count());
+	printf("Sampling:        %s\n", sampling_mode_name(mode));
+	printf("SIMD:            %s\n", simd_level_name(simd_level()));
+	printf("Points each:     %llu\n", (unsigned long long)samples);
+	printf("Mean estimate:   %.15f (+/- %.3e)\n", spread.mean, spread.mean_standard_error);
+	printf("Range:           [%.15f, %.15f]\n", spread.minimum, spread.maximum);
+	printf("Actual Pi:       %.15f\n", actual_pi);
+	printf("Empirical SE:    %.3e (spread of the estimates)\n", spread.empirical_standard_error);
+	printf("Theoretical SE:  %.3e (%.3fx empirical)\n", spread.theoretical_standard_error,
+		spread.empirical_standard_error > 0.0 ? spread.theoretical_standard_error / spread.empirical_standard_error : 0.0);
+	printf("Time:            %.3f s\n", seconds);
+	printf("Samples/sec:     %.3e\n", (double)samples * estimators / seconds);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t samples = 100000000;
+	bool samples_given = false;
+	double epsilon = 0.0;
+	double confidence = 0.95;
+	uint64_t size = 512;
+	uint64_t threads = WorkerPool::hardware_threads();
+	uint64_t seed = 0;
+	SamplingMode sampling_mode = SamplingMode::Pcg64;
+	SamplingStrategy strategy = SamplingStrategy::Plain;
+	const char *trace_path = nullptr;
+	const char *checkpoint_path = nullptr;
+	double checkpoint_interval = 60.0;
+	const char *shared_path = nullptr;
+	uint64_t slots = 64;
+	double publish_interval = 0.5;
+	uint64_t estimators = 0;
+	const char *frame_prefix = nullptr;
+	uint64_t frame_interval = 10000000;
+	ImageFormat frame_format = ImageFormat::Png;
+	const char *metrics_address = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if ((!strcmp(arg, "-n") || !strcmp(arg, "--samples")) && has_value)
+		{
+			if (!ParseCount(argv[++i], samples))
+			{
+				fprintf(stderr, "Error: invalid sample count '%s'\n", argv[i]);
+				return 1;
+			}
+			samples_given = true;
+		}
+		else if (!strcmp(arg, "--epsilon") && has_value)
+		{
+			char *end = nullptr;
+			epsilon = strtod(argv[++i], &end);
+			if (end == argv[i] || *end != '\0' || !(epsilon > 0.0))
+			{
+				fprintf(stderr, "Error: invalid epsilon '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--confidence") && has_value)
+		{
+			char *end = nullptr;
+			confidence = strtod(argv[++i], &end);
+			if (end == argv[i] || *end != '\0' || !(confidence >= 0.5 && confidence < 1.0))
+			{
+				fprintf(stderr, "Error: invalid confidence '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if ((!strcmp(arg, "-s") || !strcmp(arg, "--size")) && has_value)
+		{
+			char *end = nullptr;
+			size = strtoull(argv[++i], &end, 10);
+			if (end == argv[i] || *end != '\0' || size > 65536)
+			{
+				fprintf(stderr, "Error: invalid grid size '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if ((!strcmp(arg, "-t") || !strcmp(arg, "--threads")) && has_value)
+		{
+			if (!ParseCount(argv[++i], threads) || threads > 4096)
+			{
+				fprintf(stderr, "Error: invalid thread count '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--seed") && has_value)
+		{
+			char *end = nullptr;
+			seed = strtoull(argv[++i], &end, 0);
+			if (end == argv[i] || *end != '\0' || seed > UINT32_MAX)
+			{
+				fprintf(stderr, "Error: invalid seed '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--sampling") && has_value)
+		{
+			if (!parse_sampling_mode(argv[++i], sampling_mode))
+			{
+				fprintf(stderr, "Error: unknown sampling mode '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--strategy") && has_value)
+		{
+			if (!parse_sampling_strategy(argv[++i], strategy))
+			{
+				fprintf(stderr, "Error: unknown sampling strategy '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--simd") && has_value)
+		{
+			const char *name = argv[++i];
+			SimdLevel level = SimdLevel::Scalar;
+			if (!strcmp(name, "avx2"))
+				level = SimdLevel::Avx2;
+			else if (!strcmp(name, "avx512"))
+				level = SimdLevel::Avx512;
+			else if (strcmp(name, "scalar"))
+			{
+				fprintf(stderr, "Error: unknown SIMD level '%s'\n", name);
+				return 1;
+			}
+			set_simd_level(level);
+		}
+		else if (!strcmp(arg, "--trace") && has_value)
+		{
+			trace_path = argv[++i];
+		}
+		else if (!strcmp(arg, "--checkpoint") && has_value)
+		{
+			checkpoint_path = argv[++i];
+		}
+		else if (!strcmp(arg, "--checkpoint-interval") && has_value)
+		{
+			char *end = nullptr;
+			checkpoint_interval = strtod(argv[++i], &end);
+			if (end == argv[i] || *end != '\0' || checkpoint_interval <= 0.0)
+			{
+				fprintf(stderr, "Error: invalid checkpoint interval '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--shared") && has_value)
+		{
+			shared_path = argv[++i];
+		}
+		else if (!strcmp(arg, "--slots") && has_value)
+		{
+			if (!ParseCount(argv[++i], slots) || slots > 65536)
+			{
+				fprintf(stderr, "Error: invalid slot count '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--publish-interval") && has_value)
+		{
+			char *end = nullptr;
+			publish_interval = strtod(argv[++i], &end);
+			if (end == argv[i] || *end != '\0' || publish_interval <= 0.0)
+			{
+				fprintf(stderr, "Error: invalid publish interval '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--estimators") && has_value)
+		{
+			if (!ParseCount(argv[++i], estimators) || estimators > 65536)
+			{
+				fprintf(stderr, "Error: invalid estimator count '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--frames") && has_value)
+		{
+			frame_prefix = argv[++i];
+		}
+		else if (!strcmp(arg, "--frame-interval") && has_value)
+		{
+			if (!ParseCount(argv[++i], frame_interval))
+			{
+				fprintf(stderr, "Error: invalid frame interval '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--frame-format") && has_value)
+		{
+			if (!parse_image_format(argv[++i], frame_format))
+			{
+				fprintf(stderr, "Error: unknown frame format '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--metrics") && has_value)
+		{
+			metrics_address = argv[++i];
+		}
+		else if (!strcmp(arg, "-h") || !strcmp(arg, "--help"))
+		{
+			PrintUsage(argv[0]);
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, "Error: unknown argument '%s'\n", arg);
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (shared_path && checkpoint_path)
+	{
+		fprintf(stderr, "Error: --shared and --checkpoint cannot be combined, the region keeps every worker's counts\n");
+		return 1;
+	}
+	// A region combines the counts of its workers, which only add up for plain sampling
+	if (shared_path && strategy != SamplingStrategy::Plain)
+	{
+		fprintf(stderr, "Error: --shared needs --strategy plain\n");
+		return 1;
+	}
+	if (epsilon > 0.0 && !samples_given)
+		samples = UINT64_MAX;
+	double z = confidence_z(confidence);
+
+	profile_set_thread_name("Main");
+	if (estimators > 0)
+	{
+		if (shared_path || checkpoint_path || epsilon > 0.0 || frame_prefix || metrics_address)
+		{
+			fprintf(stderr, "Error: --estimators cannot be combined with --shared, --checkpoint, --epsilon, --frames or --metrics\n");
+			return 1;
+		}
+		if (!EstimatorBatch::supports(sampling_mode) || strategy != SamplingStrategy::Plain)
+		{
+			fprintf(stderr, "Error: --estimators needs --sampling pcg64, philox, random-exact or random and --strategy plain\n");
+			return 1;
+		}
+		// Estimators of the hash stream share its one cycle, the others take a seed each
+		uint64_t slice = EstimatorBatch::slice_samples(sampling_mode, (uint32_t)estimators);
+		if (!samples_given)
+			samples = std::min(samples, slice);
+		if (samples > slice)
+		{
+			fprintf(stderr, "Error: %llu %s estimators have %llu samples each before they overlap, -n asks for %llu\n", (unsigned long long)estimators,
+				sampling_mode_name(sampling_mode), (unsigned long long)slice, (unsigned long long)samples);
+			return 1;
+		}
+		if (slice == UINT64_MAX && seed + estimators - 1 > UINT32_MAX)
+		{
+			fprintf(stderr, "Error: seeds %llu to %llu do not all fit in 32 bits\n", (unsigned long long)seed, (unsigned long long)(seed + estimators - 1));
+			return 1;
+		}
+		RunEstimators((uint32_t)estimators, (uint32_t)seed, sampling_mode, samples, (uint32_t)threads);
+		if (trace_path && !write_chrome_trace(trace_path))
+		{
+			fprintf(stderr, "Error: cannot write trace '%s'\n", trace_path);
+			return 1;
+		}
+		return 0;
+	}
+
+	Sampler sampler((uint32_t)size, (uint32_t)threads, (uint32_t)seed);
+	sampler.set_sampling_mode(sampling_mode);
+	if (!sampler.set_sampling_strategy(strategy))
+	{
+		fprintf(stderr, "Error: --strategy %s needs an even --size%s\n", sampling_strategy_name(strategy), is_stratified(strategy) ? " other than 0" : "");
+		return 1;
+	}
+
+	// The checkpoint's grid size, seed, sampling mode and strategy take precedence, the run must continue as saved
+	std::unique_ptr<CheckpointWriter> checkpoint_writer;
+	if (checkpoint_path)
+	{
+		checkpoint_writer = std::make_unique<CheckpointWriter>();
+		if (read_checkpoint(checkpoint_path, checkpoint_writer->state()) && sampler.restore(std::move(checkpoint_writer->state())))
+			printf("Resumed:         %llu points from %s\n", (unsigned long long)sampler.total_points(), checkpoint_path);
+	}
+
+	// A worker continues whatever its slot holds, from a worker that exited or crashed
+	std::unique_ptr<SharedRegion> region;
+	if (shared_path)
+	{
+		region = std::make_unique<SharedRegion>();
+		if (!region->open(shared_path, (uint32_t)size, (uint32_t)seed, sampling_mode, (uint32_t)slots))
+		{
+			fprintf(stderr, "Error: cannot open shared region '%s' for this grid size, seed and sampling mode\n", shared_path);
+			return 1;
+		}
+		SamplerState state;
+		if (!region->claim_slot(state))
+		{
+			fprintf(stderr, "Error: all %u slots of '%s' are in use or used up\n", region->slot_count(), shared_path);
+			return 1;
+		}
+		if (!sampler.restore(std::move(state)))
+		{
+			fprintf(stderr, "Error: cannot continue slot %d of '%s', its counts do not fit this run\n", region->slot(), shared_path);
+			region->release();
+			return 1;
+		}
+		printf("Worker slot:     %d of %s (%llu points so far)\n", region->slot(), shared_path, (unsigned long long)sampler.total_points());
+	}
+
+	// Offline rendering wants every frame, so sampling waits when all frame buffers are busy
+	std::unique_ptr<FrameExporter> frame_exporter;
+	if (frame_prefix)
+	{
+		if (sampler.size() == 0)
+		{
+			fprintf(stderr, "Error: --frames needs a grid, --size 0 only counts\n");
+			return 1;
+		}
+		frame_exporter = std::make_unique<FrameExporter>(frame_prefix, frame_format);
+	}
+
+	std::unique_ptr<MetricsServer> metrics;
+	if (metrics_address)
+	{
+		metrics = std::make_unique<MetricsServer>();
+		if (!metrics->open(metrics_address))
+		{
+			fprintf(stderr, "Error: cannot serve metrics on '%s'\n", metrics_address);
+			return 1;
+		}
+	}
+	auto publish_metrics = [&](double samples_per_second, bool running) {
+		MetricsSnapshot &snapshot = metrics->snapshot();
+		snapshot.total_points = sampler.total_points();
+		snapshot.inside_circle = sampler.inside_circle();
+		snapshot.statistics = sampler.statistics(z);
+		snapshot.samples_per_second = samples_per_second;
+		snapshot.confidence = confidence;
+		snapshot.grid_size = sampler.size();
+		snapshot.thread_count = sampler.thread_count();
+		snapshot.sampling_mode = sampler.sampling_mode();
+		snapshot.sampling_strategy = sampler.sampling_strategy();
+		snapshot.accumulation_bytes = sampler.accumulation_bytes();
+		snapshot.running = running;
+		metrics->publish();
+	};
+
+	// Random and RandomExact repeat after 2^31 samples, more would only narrow the interval
+	// without adding information. A worker's slot takes a share of the period instead, and
+	// the worker stops where the next slot's range starts.
+	uint64_t period = sample_period(sampler.sampling_mode());
+	if (!region && samples > period)
+	{
+		if (samples_given)
+			fprintf(stderr, "Note: %s repeats after %llu samples, -n is capped there; the default pcg64 goes further\n", sampling_mode_name(sampler.sampling_mode()), (unsigned long long)period);
+		samples = period;
+	}
+	uint64_t slot_left = region && region->slot_end() > sampler.next_sample() ? region->slot_end() - sampler.next_sample() : 0;
+	if (region && samples > slot_left)
+	{
+		if (samples_given)
+			fprintf(stderr, "Note: slot %d of '%s' has %llu samples left, -n is capped there\n", region->slot(), shared_path, (unsigned long long)slot_left);
+		samples = slot_left;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t sampled = 0;
+	if (!checkpoint_writer && !region && epsilon == 0.0 && !frame_exporter && !metrics)
+	{
+		sampled = samples;
+		sampler.sample(samples);
+	}
+	else
+	{
+		// Sample in chunks so checkpoints can be taken, counts published, frames captured and
+		// the precision checked in between. A worker's -n counts from where its slot stood.
+		// Workers and scraped runs take smaller chunks, so what others see stays fresh.
+		uint64_t goal = region ? sampler.total_points() + std::min(samples, UINT64_MAX - sampler.total_points()) : samples;
+		auto last_checkpoint = start;
+		auto last_publish = start;
+		uint64_t chunk = (uint64_t)sampler.thread_count() << 26;
+		if (region || metrics)
+			chunk = std::min<uint64_t>(chunk, (uint64_t)sampler.thread_count() << 22);
+		while (sampler.total_points() < goal)
+		{
+			uint64_t count = std::min(chunk, goal - sampler.total_points());
+			if (epsilon > 0.0)
+			{
+				// Workers stop on the precision of the combined estimate
+				uint64_t total_points = sampler.total_points();
+				uint64_t inside_circle = sampler.inside_circle();
+				uint32_t workers = region ? std::max(region->totals(total_points, inside_circle), 1u) : 1;
+				EstimateStatistics statistics = region ? estimate_statistics(inside_circle, total_points, z) : sampler.statistics(z);
+				if (total_points > 0 && statistics.half_width <= epsilon)
+					break;
+				// Take this worker's share of what the projection says is missing, the loop
+				// re-checks after it. Before the first sample the projection is the worst
+				// case, so probe first.
+				uint64_t needed = region ? samples_for_precision(inside_circle, total_points, epsilon, z) : sampler.samples_for_precision(epsilon, z);
+				uint64_t missing = total_points > 0 && needed > total_points ? (needed - total_points) / workers : 0;
+				count = std::min(count, std::max<uint64_t>(missing, 1 << 16));
+			}
+			if (frame_exporter)
+				count = std::min(count, (sampler.total_points() / frame_interval + 1) * frame_interval - sampler.total_points());
+			sampler.sample(count);
+			sampled += count;
+			if (frame_exporter && sampler.total_points() % frame_interval == 0)
+				frame_exporter->capture(sampler, sampler.total_points() / frame_interval, true);
+
+			auto now = std::chrono::steady_clock::now();
+			if (checkpoint_writer && std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval && !checkpoint_writer->busy())
+			{
+				sampler.save(checkpoint_writer->state());
+				checkpoint_writer->submit(checkpoint_path);
+				last_checkpoint = now;
+			}
+			if (region && std::chrono::duration<double>(now - last_publish).count() >= publish_interval)
+			{
+				region->publish(sampler);
+				last_publish = now;
+			}
+			if (metrics)
+				publish_metrics(sampled / std::chrono::duration<double>(now - start).count(), true);
+		}
+
+		if (region)
+		{
+			region->publish(sampler);
+			region->release();
+		}
+
+		if (frame_exporter)
+			frame_exporter->wait();
+
+		if (checkpoint_writer)
+		{
+			checkpoint_writer->wait();
+			sampler.save(checkpoint_writer->state());
+			checkpoint_writer->submit(checkpoint_path);
+			checkpoint_writer->wait();
+			if (checkpoint_writer->failures() > 0)
+				fprintf(stderr, "Error: %llu checkpoint writes to '%s' failed\n", (unsigned long long)checkpoint_writer->failures(), checkpoint_path);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	if (metrics)
+		publish_metrics(0.0, false);
+
+	uint64_t total_points = sampler.total_points();
+	uint64_t inside_circle = sampler.inside_circle();
+	EstimateStatistics statistics = sampler.statistics(z);
+	double estimated_pi = statistics.estimate;
+	double actual_pi = 3.141592653589793;
+	double error = std::abs(estimated_pi - actual_pi);
+	// Standard error of pseudo-random sampling at this many points, to compare sequences against
+	double random_error = 4.0 * std::sqrt(0.25 * actual_pi * (1.0 - 0.25 * actual_pi) / (double)total_points);
+
+	if (sampler.size() > 0)
+		printf("Grid size:       %u x %u\n", sampler.size(), sampler.size());
+	else
+		printf("Grid size:       none (counting only)\n");
+	printf("Threads:         %u\n", sampler.thread_count());
+	printf("Seed:            %u\n", sampler.seed());
+	printf("Sampling:        %s\n", sampling_mode_name(sampler.sampling_mode()));
+	printf("Strategy:        %s\n", sampling_strategy_name(sampler.sampling_strategy()));
+	printf("SIMD:            %s\n", simd_level_name(simd_level()));
+	printf("Total points:    %llu\n", (unsigned long long)total_points);
+	printf("Inside circle:   %llu\n", (unsigned long long)inside_circle);
+	printf("Estimated Pi:    %.15f\n", estimated_pi);
+	printf("Standard error:  %.3e\n", statistics.standard_error);
+	char interval_label[32];
+	snprintf(interval_label, sizeof(interval_label), "%.4g%% CI:", confidence * 100.0);
+	printf("%-17s[%.15f, %.15f] (+/- %.3e)\n", interval_label, statistics.lower, statistics.upper, statistics.half_width);
+	if (epsilon > 0.0)
+	{
+		bool reached = statistics.half_width <= epsilon;
+		printf("Precision:       %s (target +/- %.3e)\n", reached ? "reached" : "not reached", epsilon);
+		if (!reached && !region && total_points >= period)
+			printf("                 %s repeats after %llu samples, the default pcg64 goes further\n", sampling_mode_name(sampler.sampling_mode()), (unsigned long long)period);
+	}
+	printf("Actual Pi:       %.15f\n", actual_pi);
+	printf("Error:           %.15f (%.6f%%)\n", error, error / actual_pi * 100.0);
+	printf("Random std err:  %.3e (%.2fx this error)\n", random_error, error > 0.0 ? random_error / error : 0.0);
+	// Plain pseudo-random sampling needs (random_error / standard_error)^2 times the samples
+	// for the strategy's standard error
+	if (sampler.sampling_strategy() != SamplingStrategy::Plain && statistics.standard_error > 0.0)
+		printf("Sample savings:  %.3gx fewer than plain sampling for this standard error\n", (random_error / statistics.standard_error) * (random_error / statistics.standard_error));
+	if (region)
+	{
+		uint64_t region_points = 0;
+		uint64_t region_inside = 0;
+		uint32_t workers = region->totals(region_points, region_inside);
+		EstimateStatistics combined = estimate_statistics(region_inside, region_points, z);
+		printf("Region points:   %llu (%u workers still running)\n", (unsigned long long)region_points, workers);
+		printf("Region estimate: %.15f (+/- %.3e)\n", combined.estimate, combined.half_width);
+	}
+	if (frame_exporter)
+	{
+		printf("Frames:          %llu written to %s*.%s\n", (unsigned long long)frame_exporter->written(), frame_prefix, image_format_extension(frame_format));
+		if (frame_exporter->failures() > 0)
+			fprintf(stderr, "Error: %llu frame writes failed\n", (unsigned long long)frame_exporter->failures());
+	}
+	printf("Time:            %.3f s\n", seconds);
+	printf("Samples/sec:     %.3e\n", (double)sampled / seconds);
+
+	if (trace_path && !write_chrome_trace(trace_path))
+	{
+		fprintf(stderr, "Error: cannot write trace '%s'\n", trace_path);
+		return 1;
+	}
+	return 0;
+}
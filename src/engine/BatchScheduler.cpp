@@ -0,0 +1,33 @@
+#include "BatchScheduler.h"
+
+#include <algorithm>
+
+void BatchScheduler::reset()
+{
+	m_throughput = 0.0;
+	m_last_batch = 0;
+}
+
+uint64_t BatchScheduler::next_batch() const
+{
+	if (m_throughput <= 0.0 || m_last_batch == 0)
+		return s_probe_batch;
+
+	double batch = std::min(m_throughput * m_budget, (double)m_last_batch * s_max_growth);
+	return std::clamp<uint64_t>((uint64_t)batch, 1, s_max_batch);
+}
+
+void BatchScheduler::record(uint64_t samples, double seconds)
+{
+	if (samples == 0 || seconds <= 0.0)
+		return;
+
+	// Slowdowns are taken at once so an overrun is corrected on the next batch; speedups
+	// are smoothed so one fast batch does not cause the next to overrun
+	double rate = (double)samples / seconds;
+	if (m_throughput <= 0.0 || rate < m_throughput)
+		m_throughput = rate;
+	else
+		m_throughput += s_smoothing * (rate - m_throughput);
+	m_last_batch = samples;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Sizes sampling batches so each one takes about `budget` seconds, from the throughput of
+// recent batches: slowdowns apply at once, speedups through an exponentially weighted
+// average. After reset() it probes with a small batch and then grows at most
+// s_max_growth times per batch, so a stale estimate (another grid size, fewer threads)
+// cannot produce one huge batch.
+class BatchScheduler
+{
+public:
+	void set_budget(double seconds) { m_budget = seconds > 0.0 ? seconds : s_min_budget; }
+	double budget() const { return m_budget; }
+
+	// Forgets the measured throughput, e.g. after the grid size or thread count changed
+	void reset();
+
+	uint64_t next_batch() const;
+	void record(uint64_t samples, double seconds);
+
+	// Smoothed samples per second, 0 until the first batch is recorded
+	double throughput() const { return m_throughput; }
+
+private:
+	static constexpr double s_min_budget = 1.0e-4;
+	static constexpr double s_smoothing = 0.3; // Weight of a faster batch
+	static constexpr double s_max_growth = 8.0;
+	static constexpr uint64_t s_probe_batch = 4096;
+	static constexpr uint64_t s_max_batch = 1ull << 34;
+
+	double m_budget = 1.0 / 60.0;
+	double m_throughput = 0.0;
+	uint64_t m_last_batch = 0;
+};
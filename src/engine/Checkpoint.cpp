@@ -0,0 +1,182 @@
+#include "Checkpoint.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+static_assert(std::is_trivially_copyable_v<CheckpointHeader>);
+static_assert(std::is_trivially_copyable_v<PixelCounts<uint64_t>>);
+static_assert(sizeof(CheckpointHeader) <= CheckpointHeader::s_cells_offset);
+
+static constexpr uint32_t s_version_1_header_size = offsetof(CheckpointHeader, sampling_mode);
+static constexpr uint32_t s_version_2_header_size = offsetof(CheckpointHeader, inside_pairs);
+
+static uint32_t HeaderSize(uint32_t version)
+{
+	return version == 1 ? s_version_1_header_size : version == 2 ? s_version_2_header_size : sizeof(CheckpointHeader);
+}
+
+#if defined(_WIN32)
+
+static bool ReplaceWithTemporary(const char *temporary, const char *path)
+{
+	return MoveFileExA(temporary, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+#else
+
+static bool ReplaceWithTemporary(const char *temporary, const char *path)
+{
+	return rename(temporary, path) == 0;
+}
+
+#endif
+
+bool write_checkpoint(const char *path, const SamplerState &state)
+{
+	ProfileScope scope("Checkpoint");
+
+	CheckpointHeader header = {};
+	memcpy(header.magic, CheckpointHeader::s_magic, sizeof(header.magic));
+	header.version = CheckpointHeader::s_version;
+	header.byte_order = CheckpointHeader::s_byte_order;
+	header.header_size = sizeof(CheckpointHeader);
+	header.size = state.size;
+	header.seed = state.seed;
+	header.tile_size = GridLayout::s_tile_size;
+	header.next_sample = state.next_sample;
+	header.total_points = state.total_points;
+	header.inside_circle = state.inside_circle;
+	header.cell_count = state.cells.size();
+	header.cells_offset = CheckpointHeader::s_cells_offset;
+	header.sampling_mode = (uint32_t)state.mode;
+	header.sampling_strategy = (uint32_t)state.strategy;
+	header.inside_pairs = state.inside_pairs;
+
+	std::string temp_path = std::string(path) + ".tmp";
+	uint64_t cells_bytes = header.cell_count * sizeof(PixelCounts<uint64_t>);
+	{
+		MappedFile file;
+		if (!file.create(temp_path.c_str(), header.cells_offset + cells_bytes))
+			return false;
+
+		memcpy(file.data(), &header, sizeof(header));
+		if (cells_bytes > 0)
+			memcpy(file.data() + header.cells_offset, state.cells.data(), cells_bytes);
+		if (!file.flush())
+			return false;
+	}
+	return ReplaceWithTemporary(temp_path.c_str(), path);
+}
+
+bool read_checkpoint(const char *path, SamplerState &state)
+{
+	MappedFile file;
+	if (!file.open_read(path) || file.size() < s_version_1_header_size)
+		return false;
+
+	// Version 1 headers end before sampling_mode, which then stays 0 (Random), and version 2
+	// ones before inside_pairs
+	CheckpointHeader header = {};
+	memcpy(&header, file.data(), s_version_1_header_size);
+	if (memcmp(header.magic, CheckpointHeader::s_magic, sizeof(header.magic)) != 0 ||
+		header.version < 1 || header.version > CheckpointHeader::s_version ||
+		header.byte_order != CheckpointHeader::s_byte_order ||
+		header.header_size != HeaderSize(header.version) || file.size() < header.header_size)
+		return false;
+	memcpy(&header, file.data(), header.header_size);
+	SamplingStrategy strategy = (SamplingStrategy)header.sampling_strategy;
+	if (header.tile_size != GridLayout::s_tile_size ||
+		header.inside_circle > header.total_points ||
+		header.sampling_mode >= (uint32_t)SamplingMode::Count ||
+		strategy >= SamplingStrategy::Count || !supports_size(strategy, header.size))
+		return false;
+
+	uint64_t tiles_per_row = GridLayout::tiles_per_row(grid_width(strategy, header.size));
+	uint64_t cells_bytes = header.cell_count * sizeof(PixelCounts<uint64_t>);
+	if (header.cell_count != tiles_per_row * tiles_per_row * GridLayout::s_tile_cells ||
+		header.cells_offset < header.header_size ||
+		file.size() < header.cells_offset + cells_bytes)
+		return false;
+
+	state.size = header.size;
+	state.seed = header.seed;
+	state.mode = (SamplingMode)header.sampling_mode;
+	state.strategy = strategy;
+	state.next_sample = header.next_sample;
+	state.total_points = header.total_points;
+	state.inside_circle = header.inside_circle;
+	state.inside_pairs = header.inside_pairs;
+	state.cells.resize(header.cell_count);
+	if (cells_bytes > 0)
+		memcpy(state.cells.data(), file.data() + header.cells_offset, cells_bytes);
+	return true;
+}
+
+CheckpointWriter::CheckpointWriter()
+{
+	m_thread = std::thread(&CheckpointWriter::thread_loop, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+void CheckpointWriter::submit(std::string path)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_path = std::move(path);
+		m_busy.store(true, std::memory_order_release);
+	}
+	m_wake.notify_one();
+}
+
+void CheckpointWriter::wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_done.wait(lock, [this] { return !m_busy.load(std::memory_order_relaxed); });
+}
+
+void CheckpointWriter::thread_loop()
+{
+	profile_set_thread_name("Checkpoint");
+	while (true)
+	{
+		std::string path;
+		{
+			std::unique_lock lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stop || m_busy.load(std::memory_order_relaxed); });
+			// A submitted checkpoint is still written when stopping
+			if (!m_busy.load(std::memory_order_relaxed))
+				return;
+			path = m_path;
+		}
+
+		if (write_checkpoint(path.c_str(), m_state))
+			m_written_points.store(m_state.total_points, std::memory_order_relaxed);
+		else
+			m_failures.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			std::lock_guard lock(m_mutex);
+			m_busy.store(false, std::memory_order_release);
+		}
+		m_done.notify_all();
+	}
+}
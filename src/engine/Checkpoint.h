@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Checkpoint file: a fixed header followed, at a page-aligned offset, by the grid's
+// cells exactly as they sit in memory (GridLayout order, 64-bit inside/total counts).
+// Loading maps the file and copies the cells in one go; there is nothing to parse.
+// Files are only readable on machines with the byte order that wrote them.
+struct CheckpointHeader
+{
+	static constexpr char s_magic[8] = {'P', 'I', 'C', 'H', 'K', 'P', 'T', '\0'};
+	static constexpr uint32_t s_version = 3;
+	static constexpr uint32_t s_byte_order = 0x01020304;
+	static constexpr uint64_t s_cells_offset = 4096;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t header_size;
+	uint32_t size;
+	uint32_t seed;
+	uint32_t tile_size; // GridLayout::s_tile_size the cells were stored with
+	uint64_t next_sample;
+	uint64_t total_points;
+	uint64_t inside_circle;
+	uint64_t cell_count;
+	uint64_t cells_offset;
+	// Version 2 on; version 1 files were all SamplingMode::Random
+	uint32_t sampling_mode;
+	// Version 3 on; reserved and 0 (SamplingStrategy::Plain) in version 2
+	uint32_t sampling_strategy;
+	uint64_t inside_pairs;
+};
+
+// Writes through a memory-mapped temporary file that replaces `path` only once it is
+// complete, so a crash mid-write leaves the previous checkpoint intact
+bool write_checkpoint(const char *path, const SamplerState &state);
+bool read_checkpoint(const char *path, SamplerState &state);
+
+// Writes checkpoints on a thread of its own. The producer fills state() while the
+// writer is idle and hands it over with submit(); the file I/O never blocks it.
+class CheckpointWriter
+{
+public:
+	CheckpointWriter();
+	~CheckpointWriter();
+
+	CheckpointWriter(const CheckpointWriter &) = delete;
+	CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+	bool busy() const { return m_busy.load(std::memory_order_acquire); }
+
+	// Only valid while !busy()
+	SamplerState &state() { return m_state; }
+	void submit(std::string path);
+
+	// Blocks until the submitted checkpoint is on disk
+	void wait();
+
+	// total_points of the newest checkpoint written successfully, and failed writes
+	uint64_t written_points() const { return m_written_points.load(std::memory_order_relaxed); }
+	uint64_t failures() const { return m_failures.load(std::memory_order_relaxed); }
+
+private:
+	void thread_loop();
+
+private:
+	SamplerState m_state;
+	std::string m_path;
+	std::atomic<bool> m_busy = false;
+	std::atomic<uint64_t> m_written_points = 0;
+	std::atomic<uint64_t> m_failures = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	bool m_stop = false;
+
+	std::thread m_thread;
+};
@@ -0,0 +1,101 @@
+#include "ConvergenceHistory.h"
+
+#include <bit>
+#include <stdio.h>
+
+uint32_t ConvergenceHistory::bucket_index(uint64_t total_points)
+{
+	uint32_t octave = (uint32_t)std::bit_width(total_points) - 1;
+	uint32_t fraction = (uint32_t)((total_points << (63 - octave)) >> 60) & (s_buckets_per_octave - 1);
+	return octave * s_buckets_per_octave + fraction;
+}
+
+void ConvergenceHistory::store(Bucket &bucket, const Point &point)
+{
+	uint64_t sequence = bucket.sequence.load(std::memory_order_relaxed);
+	bucket.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bucket.total_points.store(point.total_points, std::memory_order_relaxed);
+	bucket.inside_circle.store(point.inside_circle, std::memory_order_relaxed);
+	bucket.estimate.store(std::bit_cast<uint64_t>(point.estimate), std::memory_order_relaxed);
+	bucket.standard_error.store(std::bit_cast<uint64_t>(point.standard_error), std::memory_order_relaxed);
+	bucket.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void ConvergenceHistory::append(uint64_t total_points, uint64_t inside_circle, const EstimateStatistics &statistics)
+{
+	if (total_points == 0)
+		return;
+	uint32_t bucket = bucket_index(total_points);
+	if (bucket < m_last_bucket)
+		return;
+
+	store(m_buckets[bucket], {total_points, inside_circle, statistics.estimate, statistics.standard_error});
+	m_last_bucket = bucket;
+	m_version.fetch_add(1, std::memory_order_release);
+}
+
+void ConvergenceHistory::clear()
+{
+	m_clears.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (uint32_t bucket = 0; bucket <= m_last_bucket; ++bucket)
+	{
+		if (m_buckets[bucket].total_points.load(std::memory_order_relaxed) != 0)
+			store(m_buckets[bucket], {0, 0, 0.0, 0.0});
+	}
+	m_last_bucket = 0;
+	m_clears.fetch_add(1, std::memory_order_release);
+	m_version.fetch_add(1, std::memory_order_release);
+}
+
+void ConvergenceHistory::read(std::vector<Point> &points) const
+{
+	// A clear in the middle of the copy could mix two runs, start over then
+	while (true)
+	{
+		uint64_t clears = m_clears.load(std::memory_order_acquire);
+		if (clears & 1)
+			continue;
+
+		points.clear();
+		for (const Bucket &bucket : m_buckets)
+		{
+			Point point;
+			while (true)
+			{
+				uint64_t sequence = bucket.sequence.load(std::memory_order_acquire);
+				point = {bucket.total_points.load(std::memory_order_relaxed), bucket.inside_circle.load(std::memory_order_relaxed),
+					std::bit_cast<double>(bucket.estimate.load(std::memory_order_relaxed)),
+					std::bit_cast<double>(bucket.standard_error.load(std::memory_order_relaxed))};
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (!(sequence & 1) && bucket.sequence.load(std::memory_order_relaxed) == sequence)
+					break;
+			}
+			if (point.total_points != 0)
+				points.push_back(point);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_clears.load(std::memory_order_relaxed) == clears)
+			return;
+	}
+}
+
+bool ConvergenceHistory::write_csv(const char *path) const
+{
+	std::vector<Point> points;
+	read(points);
+
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "samples,inside,estimate,error,standard_error\n");
+	for (const Point &point : points)
+	{
+		fprintf(file, "%llu,%llu,%.15f,%.6e,%.6e\n", (unsigned long long)point.total_points, (unsigned long long)point.inside_circle,
+			point.estimate, point.estimate - 3.141592653589793, point.standard_error);
+	}
+	return fclose(file) == 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Statistics.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Estimate versus sample count over a whole run, in constant memory. Sample counts map to
+// log-spaced buckets, s_buckets_per_octave per power of two, and each bucket keeps the
+// newest counts that fell into it; a run of 10^12 samples fills about 320 of them.
+//
+// One thread appends, any number of threads read, and nobody takes a lock: every bucket
+// is a seqlock, so a reader retries a bucket the writer changed while it was copying it.
+class ConvergenceHistory
+{
+public:
+	static constexpr uint32_t s_buckets_per_octave = 8;
+	static constexpr uint32_t s_bucket_count = 64 * s_buckets_per_octave;
+
+	// The estimate and its standard error are the run's own at the time, which depend on
+	// the sampling strategy and not only on the counts
+	struct Point
+	{
+		uint64_t total_points;
+		uint64_t inside_circle;
+		double estimate;
+		double standard_error;
+	};
+
+	// Writer side. Counts must grow between clear() calls, points that do not are dropped.
+	void append(uint64_t total_points, uint64_t inside_circle, const EstimateStatistics &statistics);
+	void clear();
+
+	// Reader side. version() changes with every append or clear, so a reader can skip
+	// read() while it is the same. read() returns the recorded points, oldest first.
+	uint64_t version() const { return m_version.load(std::memory_order_acquire); }
+	void read(std::vector<Point> &points) const;
+
+	// samples,inside,estimate,error,standard_error per point
+	bool write_csv(const char *path) const;
+
+	// Bucket of a positive sample count: the octave and the next 3 bits below the top one
+	static uint32_t bucket_index(uint64_t total_points);
+
+private:
+	struct Bucket
+	{
+		std::atomic<uint64_t> sequence = 0; // Odd while the writer changes the bucket
+		std::atomic<uint64_t> total_points = 0; // 0 when empty
+		std::atomic<uint64_t> inside_circle = 0;
+		std::atomic<uint64_t> estimate = 0; // Bits of the double
+		std::atomic<uint64_t> standard_error = 0;
+	};
+
+	void store(Bucket &bucket, const Point &point);
+
+	std::array<Bucket, s_bucket_count> m_buckets;
+	std::atomic<uint64_t> m_version = 0;
+	std::atomic<uint64_t> m_clears = 0; // Odd while clear() empties the buckets
+	uint32_t m_last_bucket = 0; // Writer only, highest bucket written since the last clear
+};
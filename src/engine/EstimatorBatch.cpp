@@ -0,0 +1,57 @@
+#include "EstimatorBatch.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "SimdKernel.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+EstimatorBatch::EstimatorBatch(uint32_t estimator_count, uint32_t first_seed, SamplingMode mode, uint32_t thread_count)
+	: m_pool(std::make_unique<WorkerPool>(std::max(thread_count, 1u))), m_mode(mode), m_seeds(estimator_count), m_inside(estimator_count, 0)
+{
+	uint64_t slice = slice_samples(mode, estimator_count);
+	for (uint32_t k = 0; k < estimator_count; ++k)
+		m_seeds[k] = is_hash_stream(mode) ? random_advance(first_seed, 2 * k * slice) : first_seed + k;
+}
+
+EstimatorBatch::~EstimatorBatch() = default;
+
+uint32_t EstimatorBatch::thread_count() const
+{
+	return m_pool->thread_count();
+}
+
+void EstimatorBatch::sample(uint64_t count)
+{
+	ProfileScope scope("Sample estimators");
+
+	uint32_t worker_count = (uint32_t)std::clamp<uint64_t>(count / s_min_samples_per_worker, 1, thread_count());
+	if (m_worker_inside.size() < worker_count)
+		m_worker_inside.resize(worker_count);
+
+	bool exact = m_mode == SamplingMode::RandomExact;
+	uint64_t chunk = count / worker_count;
+	m_pool->run(worker_count, [&](uint32_t worker) {
+		ProfileScope scope("Count estimators");
+		std::vector<uint64_t> &inside = m_worker_inside[worker];
+		inside.resize(m_seeds.size());
+		uint64_t first = chunk * worker;
+		uint64_t worker_samples = worker + 1 == worker_count ? count - first : chunk;
+		if (is_hash_stream(m_mode))
+			count_inside_batch(m_seeds.data(), estimator_count(), m_next_sample + first, worker_samples, exact, inside.data());
+		else if (m_mode == SamplingMode::Philox)
+			count_inside_philox_batch(m_seeds.data(), estimator_count(), m_next_sample + first, worker_samples, inside.data());
+		else
+		{
+			for (uint32_t k = 0; k < estimator_count(); ++k)
+				inside[k] = count_inside_sequence(m_mode, m_seeds[k], m_next_sample + first, worker_samples);
+		}
+	});
+
+	for (uint32_t worker = 0; worker < worker_count; ++worker)
+	{
+		for (size_t k = 0; k < m_inside.size(); ++k)
+			m_inside[k] += m_worker_inside[worker][k];
+	}
+	m_next_sample += count;
+}
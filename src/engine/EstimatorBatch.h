@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Sequence.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WorkerPool;
+
+// Independent estimates of pi advanced together, counting only, for variance studies.
+// With Pcg64 or Philox, estimator k is the run seeded with first_seed + k: each seed is a
+// stream of its own (a PCG increment or a Philox key), so the estimators never share a
+// point and run as long as asked. Philox computes the estimators in lanes of one loop.
+//
+// Random and RandomExact are the fast opt-in: the SIMD kernel gives each estimator a lane
+// (see count_inside_batch()). Nearby seeds of the hash stream would walk the same
+// 2^31-sample cycle (see sample_period()), so estimator k instead takes samples
+// [k * slice_samples(), (k + 1) * slice_samples()) of the run seeded with first_seed, and
+// stays independent only up to slice_samples() samples; sample() does not check.
+//
+// Seeds and counts are kept as arrays. Workers split the samples, each advancing every
+// estimator through its own slice.
+class EstimatorBatch
+{
+public:
+	EstimatorBatch(uint32_t estimator_count, uint32_t first_seed, SamplingMode mode, uint32_t thread_count = 1);
+	~EstimatorBatch();
+
+	static bool supports(SamplingMode mode) { return is_hash_stream(mode) || mode == SamplingMode::Pcg64 || mode == SamplingMode::Philox; }
+	// Samples each of `estimator_count` estimators has to itself, UINT64_MAX unless the
+	// mode is the hash stream
+	static uint64_t slice_samples(SamplingMode mode, uint32_t estimator_count) { return is_hash_stream(mode) ? sample_period(mode) / std::max(estimator_count, 1u) : UINT64_MAX; }
+
+	// Adds `count` samples to every estimator
+	void sample(uint64_t count);
+
+	uint32_t estimator_count() const { return (uint32_t)m_seeds.size(); }
+	uint32_t thread_count() const;
+	SamplingMode sampling_mode() const { return m_mode; }
+	uint64_t slice_samples() const { return slice_samples(m_mode, estimator_count()); }
+	// Per estimator
+	const std::vector<uint64_t> &inside_circle() const { return m_inside; }
+	uint64_t samples_per_estimator() const { return m_next_sample; }
+
+private:
+	static bool is_hash_stream(SamplingMode mode) { return mode == SamplingMode::Random || mode == SamplingMode::RandomExact; }
+
+	// Splitting finer than this costs more in setup than the extra threads save
+	static constexpr uint64_t s_min_samples_per_worker = 1 << 16;
+
+	std::unique_ptr<WorkerPool> m_pool;
+	SamplingMode m_mode;
+	// Seed of each estimator, or for the hash stream its state at the estimator's first sample
+	std::vector<uint32_t> m_seeds;
+	std::vector<uint64_t> m_inside;
+	std::vector<std::vector<uint64_t>> m_worker_inside;
+	uint64_t m_next_sample = 0;
+};
@@ -0,0 +1,270 @@
+#include "FrameExporter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <stdio.h>
+#include <string.h>
+
+bool parse_image_format(const char *name, ImageFormat &format)
+{
+	if (!strcmp(name, "ppm"))
+		format = ImageFormat::Ppm;
+	else if (!strcmp(name, "png"))
+		format = ImageFormat::Png;
+	else
+		return false;
+	return true;
+}
+
+const char *image_format_extension(ImageFormat format)
+{
+	return format == ImageFormat::Png ? "png" : "ppm";
+}
+
+static const std::array<uint32_t, 256> &Crc32Table()
+{
+	static const std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> entries;
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; ++bit)
+				crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+			entries[i] = crc;
+		}
+		return entries;
+	}();
+	return table;
+}
+
+static void AppendBigEndian(std::vector<uint8_t> &out, uint32_t value)
+{
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+// Length, type and data are already in `out` from `chunk_start` on; the CRC covers type and data
+static void FinishChunk(std::vector<uint8_t> &out, size_t chunk_start)
+{
+	uint32_t length = (uint32_t)(out.size() - chunk_start - 8);
+	for (int i = 0; i < 4; ++i)
+		out[chunk_start + i] = (uint8_t)(length >> (24 - 8 * i));
+
+	const std::array<uint32_t, 256> &table = Crc32Table();
+	uint32_t crc = 0xffffffffu;
+	for (size_t i = chunk_start + 4; i < out.size(); ++i)
+		crc = table[(crc ^ out[i]) & 0xff] ^ (crc >> 8);
+	AppendBigEndian(out, crc ^ 0xffffffffu);
+}
+
+static size_t BeginChunk(std::vector<uint8_t> &out, const char *type)
+{
+	size_t chunk_start = out.size();
+	out.insert(out.end(), 4, 0);
+	out.insert(out.end(), type, type + 4);
+	return chunk_start;
+}
+
+static void EncodePng(const uint32_t *pixels, uint32_t size, std::vector<uint8_t> &out)
+{
+	static constexpr uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	out.assign(signature, signature + sizeof(signature));
+
+	size_t chunk = BeginChunk(out, "IHDR");
+	AppendBigEndian(out, size);
+	AppendBigEndian(out, size);
+	out.insert(out.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, no filter, no interlace
+	FinishChunk(out, chunk);
+
+	// zlib stream of stored blocks holding the rows, each behind a "no filter" byte
+	uint64_t row_bytes = 1 + 3 * (uint64_t)size;
+	uint64_t raw_left = row_bytes * size;
+	chunk = BeginChunk(out, "IDAT");
+	out.insert(out.end(), {0x78, 0x01});
+	out.reserve(out.size() + raw_left + raw_left / 65535 * 5 + 64);
+	std::vector<uint8_t> row(row_bytes);
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	uint64_t block_left = 0;
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		row[0] = 0;
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			uint32_t pixel = pixels[(size_t)y * size + x];
+			row[1 + 3 * x + 0] = (uint8_t)(pixel >> 24);
+			row[1 + 3 * x + 1] = (uint8_t)(pixel >> 16);
+			row[1 + 3 * x + 2] = (uint8_t)(pixel >> 8);
+		}
+
+		// Sums stay below 2^32 for 5552 bytes between reductions
+		for (uint64_t begin = 0; begin < row_bytes; begin += 5552)
+		{
+			uint64_t end = std::min<uint64_t>(row_bytes, begin + 5552);
+			for (uint64_t i = begin; i < end; ++i)
+			{
+				adler_a += row[i];
+				adler_b += adler_a;
+			}
+			adler_a %= 65521;
+			adler_b %= 65521;
+		}
+
+		for (uint64_t offset = 0; offset < row_bytes;)
+		{
+			if (block_left == 0)
+			{
+				block_left = std::min<uint64_t>(raw_left, 65535);
+				raw_left -= block_left;
+				uint16_t length = (uint16_t)block_left;
+				out.insert(out.end(), {(uint8_t)(raw_left == 0), (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)~length, (uint8_t)(~length >> 8)});
+			}
+			uint64_t copy = std::min(block_left, row_bytes - offset);
+			out.insert(out.end(), row.begin() + offset, row.begin() + offset + copy);
+			offset += copy;
+			block_left -= copy;
+		}
+	}
+	AppendBigEndian(out, (adler_b << 16) | adler_a);
+	FinishChunk(out, chunk);
+
+	chunk = BeginChunk(out, "IEND");
+	FinishChunk(out, chunk);
+}
+
+static void EncodePpm(const uint32_t *pixels, uint32_t size, std::vector<uint8_t> &out)
+{
+	char header[64];
+	int header_length = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", size, size);
+	out.assign(header, header + header_length);
+	out.resize(out.size() + 3 * (size_t)size * size);
+	uint8_t *rgb = out.data() + header_length;
+	for (size_t i = 0; i < (size_t)size * size; ++i)
+	{
+		rgb[3 * i + 0] = (uint8_t)(pixels[i] >> 24);
+		rgb[3 * i + 1] = (uint8_t)(pixels[i] >> 16);
+		rgb[3 * i + 2] = (uint8_t)(pixels[i] >> 8);
+	}
+}
+
+bool write_image(const char *path, ImageFormat format, const uint32_t *pixels, uint32_t size, std::vector<uint8_t> &scratch)
+{
+	if (format == ImageFormat::Png)
+		EncodePng(pixels, size, scratch);
+	else
+		EncodePpm(pixels, size, scratch);
+
+	FILE *file = fopen(path, "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(scratch.data(), 1, scratch.size(), file) == scratch.size();
+	return fclose(file) == 0 && written;
+}
+
+FrameExporter::FrameExporter(std::string prefix, ImageFormat format, uint32_t thread_count, uint32_t buffer_count)
+	: m_prefix(std::move(prefix)), m_format(format)
+{
+	for (uint32_t i = 0; i < std::max(buffer_count, 1u); ++i)
+	{
+		m_frames.push_back(std::make_unique<Frame>());
+		m_free.push_back(m_frames.back().get());
+	}
+	for (uint32_t i = 0; i < std::max(thread_count, 1u); ++i)
+		m_threads.emplace_back(&FrameExporter::thread_loop, this);
+}
+
+FrameExporter::~FrameExporter()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread &thread : m_threads)
+		thread.join();
+}
+
+bool FrameExporter::capture(Sampler &sampler, uint64_t number, bool wait_for_buffer)
+{
+	Frame *frame = nullptr;
+	{
+		std::unique_lock lock(m_mutex);
+		if (wait_for_buffer)
+			m_done.wait(lock, [this] { return !m_free.empty(); });
+		if (m_free.empty())
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		frame = m_free.back();
+		m_free.pop_back();
+	}
+
+	// The buffer still holds the frame it was last used for
+	ProfileScope scope("Capture frame");
+	uint32_t size = sampler.display_size();
+	if (frame->size != size)
+	{
+		frame->size = size;
+		frame->pixels.resize((size_t)size * size);
+		frame->version = 0;
+	}
+	sampler.resolve(frame->pixels.data(), frame->version);
+	frame->version = sampler.version();
+	frame->number = number;
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_queue.push_back(frame);
+	}
+	m_wake.notify_one();
+	return true;
+}
+
+void FrameExporter::wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_done.wait(lock, [this] { return m_queue.empty() && m_writing == 0; });
+}
+
+void FrameExporter::thread_loop()
+{
+	profile_set_thread_name("Frame export");
+	std::vector<uint8_t> scratch;
+	std::string path;
+	while (true)
+	{
+		Frame *frame = nullptr;
+		{
+			std::unique_lock lock(m_mutex);
+			// Queued frames are still written when stopping
+			m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			if (m_queue.empty())
+				return;
+			frame = m_queue.front();
+			m_queue.pop_front();
+			m_writing++;
+		}
+
+		{
+			ProfileScope scope("Write frame");
+			char number[32];
+			snprintf(number, sizeof(number), "%06llu.", (unsigned long long)frame->number);
+			path = m_prefix + number + image_format_extension(m_format);
+			if (write_image(path.c_str(), m_format, frame->pixels.data(), frame->size, scratch))
+				m_written.fetch_add(1, std::memory_order_relaxed);
+			else
+				m_failures.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard lock(m_mutex);
+			m_free.push_back(frame);
+			m_writing--;
+		}
+		m_done.notify_all();
+	}
+}
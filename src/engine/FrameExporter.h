@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ImageFormat
+{
+	Ppm,
+	Png,
+};
+
+bool parse_image_format(const char *name, ImageFormat &format);
+const char *image_format_extension(ImageFormat format);
+
+// size * size RGBA8888 pixels as binary PPM, or as PNG with uncompressed (stored) deflate
+// blocks: no zlib needed, and encoding is a copy plus two checksums. Both keep RGB only.
+// `scratch` is reused between calls.
+bool write_image(const char *path, ImageFormat format, const uint32_t *pixels, uint32_t size, std::vector<uint8_t> &scratch);
+
+// Writes numbered images of a run, <prefix>000042.png and so on, on background threads.
+//
+// A fixed set of frame buffers is recycled: capture() resolves the sampler into a free
+// one and queues it, encoder threads write queued frames and hand the buffers back. When
+// every buffer is queued or being written, capture() drops the frame rather than wait on
+// the disk, unless asked to wait. Each buffer remembers the version it was resolved at,
+// so capturing only re-resolves the tiles that changed since the buffer was last used.
+class FrameExporter
+{
+public:
+	FrameExporter(std::string prefix, ImageFormat format, uint32_t thread_count = 2, uint32_t buffer_count = 4);
+	~FrameExporter(); // Writes every queued frame first
+
+	FrameExporter(const FrameExporter &) = delete;
+	FrameExporter &operator=(const FrameExporter &) = delete;
+
+	// Queues the sampler's image as frame `number`. Returns false if it was dropped.
+	bool capture(Sampler &sampler, uint64_t number, bool wait_for_buffer = false);
+	// Blocks until every queued frame is written
+	void wait();
+
+	uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+	uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+	uint64_t failures() const { return m_failures.load(std::memory_order_relaxed); }
+
+private:
+	struct Frame
+	{
+		uint64_t number = 0;
+		uint32_t size = 0;
+		uint64_t version = 0; // Sampler version the pixels are current as of
+		std::vector<uint32_t> pixels;
+	};
+
+	void thread_loop();
+
+private:
+	std::string m_prefix;
+	ImageFormat m_format;
+	std::vector<std::unique_ptr<Frame>> m_frames;
+	std::atomic<uint64_t> m_written = 0;
+	std::atomic<uint64_t> m_dropped = 0;
+	std::atomic<uint64_t> m_failures = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::vector<Frame *> m_free;
+	std::deque<Frame *> m_queue;
+	uint32_t m_writing = 0;
+	bool m_stop = false;
+
+	std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// Accumulation grids are stored tile-major: the grid is cut into s_tile_size square tiles
+// in row order, each tile is row-major inside and padded to a full tile. Samples that land
+// near each other then share cache lines and pages, and a tile is one contiguous range
+// that can be merged, resolved or binned as a unit.
+//
+// The per-ISA kernels only use the constants (see SimdKernelIsa.h).
+struct GridLayout
+{
+	static constexpr uint32_t s_tile_shift = 6;
+	static constexpr uint32_t s_tile_size = 1u << s_tile_shift;
+	static constexpr uint32_t s_tile_cell_shift = s_tile_shift * 2;
+	static constexpr uint32_t s_tile_cells = 1u << s_tile_cell_shift;
+
+	static uint32_t tiles_per_row(uint32_t size)
+	{
+		return (size + s_tile_size - 1) >> s_tile_shift;
+	}
+
+	// Cell of pixel (x, y) in a grid tiles_per_row tiles wide
+	static uint32_t cell_index(uint32_t x, uint32_t y, uint32_t tiles_per_row)
+	{
+		uint32_t tile = (y >> s_tile_shift) * tiles_per_row + (x >> s_tile_shift);
+		return (tile << s_tile_cell_shift) | ((y & (s_tile_size - 1)) << s_tile_shift) | (x & (s_tile_size - 1));
+	}
+
+	static uint32_t tile_of(uint32_t cell_index)
+	{
+		return cell_index >> s_tile_cell_shift;
+	}
+};
@@ -0,0 +1,134 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+static bool MapWholeFile(HANDLE file, bool writable, uint64_t size, void *&mapping, uint8_t *&data)
+{
+	mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(size >> 32), (DWORD)size, nullptr);
+	if (!mapping)
+		return false;
+	data = (uint8_t *)MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	return data != nullptr;
+}
+
+static bool OpenExisting(const char *path, bool writable, void *&handle, uint64_t &size)
+{
+	DWORD access = writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+	DWORD share = writable ? FILE_SHARE_READ | FILE_SHARE_WRITE : FILE_SHARE_READ;
+	HANDLE file = CreateFileA(path, access, share, nullptr, OPEN_EXISTING, writable ? FILE_ATTRIBUTE_NORMAL : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		return false;
+	size = (uint64_t)file_size.QuadPart;
+	return true;
+}
+
+bool MappedFile::open_read(const char *path)
+{
+	return OpenExisting(path, false, m_file, m_size) && MapWholeFile(m_file, false, 0, m_mapping, m_data);
+}
+
+bool MappedFile::open_write(const char *path)
+{
+	return OpenExisting(path, true, m_file, m_size) && MapWholeFile(m_file, true, 0, m_mapping, m_data);
+}
+
+bool MappedFile::create(const char *path, uint64_t size, bool exclusive)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, exclusive ? CREATE_NEW : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = file;
+	m_size = size;
+	return MapWholeFile(m_file, true, size, m_mapping, m_data);
+}
+
+bool MappedFile::flush()
+{
+	return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file);
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+}
+
+#else
+
+static bool MapWholeFile(int file, bool writable, uint64_t size, uint8_t *&data)
+{
+	void *mapped = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, writable ? MAP_SHARED : MAP_PRIVATE, file, 0);
+	if (mapped == MAP_FAILED)
+		return false;
+	data = (uint8_t *)mapped;
+	return true;
+}
+
+static bool OpenExisting(const char *path, bool writable, int &file, uint64_t &size)
+{
+	file = ::open(path, writable ? O_RDWR : O_RDONLY);
+	struct stat info;
+	if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+		return false;
+	size = (uint64_t)info.st_size;
+	return true;
+}
+
+bool MappedFile::open_read(const char *path)
+{
+	return OpenExisting(path, false, m_file, m_size) && MapWholeFile(m_file, false, m_size, m_data);
+}
+
+bool MappedFile::open_write(const char *path)
+{
+	return OpenExisting(path, true, m_file, m_size) && MapWholeFile(m_file, true, m_size, m_data);
+}
+
+bool MappedFile::create(const char *path, uint64_t size, bool exclusive)
+{
+	m_file = ::open(path, exclusive ? O_RDWR | O_CREAT | O_EXCL : O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_file < 0 || ftruncate(m_file, (off_t)size) != 0)
+		return false;
+	m_size = size;
+	return MapWholeFile(m_file, true, m_size, m_data);
+}
+
+bool MappedFile::flush()
+{
+	return msync(m_data, m_size, MS_SYNC) == 0 && fsync(m_file) == 0;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		munmap(m_data, m_size);
+	if (m_file >= 0)
+		::close(m_file);
+	m_data = nullptr;
+	m_file = -1;
+}
+
+#endif
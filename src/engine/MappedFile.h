@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// A whole file mapped into memory: read-only, read-write, or created at a given size.
+// Writable mappings are shared, so several processes mapping the same file see each
+// other's writes.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool open_read(const char *path);
+	bool open_write(const char *path);
+	// Fails if `exclusive` and the file already exists
+	bool create(const char *path, uint64_t size, bool exclusive = false);
+	bool flush();
+	void close();
+
+	uint8_t *data() const { return m_data; }
+	uint64_t size() const { return m_size; }
+
+private:
+	uint8_t *m_data = nullptr;
+	uint64_t m_size = 0;
+#if defined(_WIN32)
+	void *m_file = nullptr; // HANDLEs
+	void *m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+};
@@ -0,0 +1,334 @@
+#include "MetricsServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+using Socket = SOCKET;
+static const Socket s_invalid_socket = INVALID_SOCKET;
+
+static bool StartSockets()
+{
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+
+static void CloseSocket(Socket socket)
+{
+	closesocket(socket);
+}
+
+static int PollSocket(Socket socket, int milliseconds)
+{
+	WSAPOLLFD entry = {socket, POLLRDNORM, 0};
+	return WSAPoll(&entry, 1, milliseconds);
+}
+
+#else
+
+using Socket = int;
+static const Socket s_invalid_socket = -1;
+
+static bool StartSockets()
+{
+	return true;
+}
+
+static void CloseSocket(Socket socket)
+{
+	close(socket);
+}
+
+static int PollSocket(Socket socket, int milliseconds)
+{
+	pollfd entry = {socket, POLLIN, 0};
+	return poll(&entry, 1, milliseconds);
+}
+
+#endif
+
+static Socket ListenTcp(const char *host, const char *port)
+{
+	// getaddrinfo() would take "99999" modulo 65536
+	char *end = nullptr;
+	unsigned long number = strtoul(port, &end, 10);
+	if (end == port || *end != '\0' || number > 65535)
+		return s_invalid_socket;
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *addresses = nullptr;
+	if (getaddrinfo(host, port, &hints, &addresses) != 0)
+		return s_invalid_socket;
+
+	Socket listener = s_invalid_socket;
+	for (addrinfo *address = addresses; address && listener == s_invalid_socket; address = address->ai_next)
+	{
+		listener = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (listener == s_invalid_socket)
+			continue;
+		int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+		if (bind(listener, address->ai_addr, (int)address->ai_addrlen) != 0 || listen(listener, 8) != 0)
+		{
+			CloseSocket(listener);
+			listener = s_invalid_socket;
+		}
+	}
+	freeaddrinfo(addresses);
+	return listener;
+}
+
+static Socket ListenUnix(const char *path)
+{
+#if defined(_WIN32)
+	(void)path;
+	return s_invalid_socket;
+#else
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+		return s_invalid_socket;
+	strcpy(address.sun_path, path);
+
+	Socket listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == s_invalid_socket)
+		return s_invalid_socket;
+	// A socket file left behind by a previous run would fail the bind
+	unlink(path);
+	if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 8) != 0)
+	{
+		CloseSocket(listener);
+		return s_invalid_socket;
+	}
+	return listener;
+#endif
+}
+
+bool MetricsServer::open(const char *address)
+{
+	if (m_thread.joinable() || !StartSockets())
+		return false;
+
+	Socket listener = s_invalid_socket;
+	if (!strncmp(address, "unix:", 5))
+	{
+		m_unix_path = address + 5;
+		listener = ListenUnix(m_unix_path.c_str());
+	}
+	else
+	{
+		std::string host = "127.0.0.1";
+		const char *port = address;
+		if (const char *colon = strrchr(address, ':'))
+		{
+			host.assign(address, colon);
+			port = colon + 1;
+		}
+		listener = ListenTcp(host.c_str(), port);
+	}
+	if (listener == s_invalid_socket)
+	{
+		m_unix_path.clear();
+		return false;
+	}
+
+	m_address = address;
+	m_socket = (intptr_t)listener;
+	m_thread = std::thread(&MetricsServer::thread_loop, this);
+	return true;
+}
+
+MetricsServer::~MetricsServer()
+{
+	if (!m_thread.joinable())
+		return;
+	m_stop.store(true, std::memory_order_relaxed);
+	m_thread.join();
+	CloseSocket((Socket)m_socket);
+#if !defined(_WIN32)
+	if (!m_unix_path.empty())
+		unlink(m_unix_path.c_str());
+#endif
+}
+
+void MetricsServer::thread_loop()
+{
+	profile_set_thread_name("Metrics");
+	Socket listener = (Socket)m_socket;
+	std::string request;
+	while (!m_stop.load(std::memory_order_relaxed))
+	{
+		collect_stages();
+		if (PollSocket(listener, s_poll_milliseconds) <= 0)
+			continue;
+		Socket client = accept(listener, nullptr, nullptr);
+		if (client == s_invalid_socket)
+			continue;
+
+		// Read the request head, but never let a slow client hold the thread for longer than
+		// s_request_milliseconds in total
+		request.clear();
+		char buffer[1024];
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(s_request_milliseconds);
+		while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos)
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (remaining <= 0 || PollSocket(client, (int)remaining) <= 0)
+				break;
+			int received = (int)recv(client, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+				break;
+			request.append(buffer, (size_t)received);
+		}
+
+		std::string response;
+		if (!request.starts_with("GET "))
+		{
+			response = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		}
+		else
+		{
+			collect_stages();
+			std::string body = render();
+			char header[160];
+			snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+			response = header + body;
+		}
+		for (size_t sent = 0; sent < response.size();)
+		{
+			int written = (int)send(client, response.data() + sent, (int)(response.size() - sent), 0);
+			if (written <= 0)
+				break;
+			sent += (size_t)written;
+		}
+		CloseSocket(client);
+	}
+}
+
+void MetricsServer::collect_stages()
+{
+	m_events.clear();
+	profile_collect(m_cursor, m_events);
+	for (const ProfileEvent &event : m_events)
+	{
+		auto found = std::ranges::find_if(m_stages, [&](const StageTotals &stage) { return strcmp(stage.name, event.name) == 0; });
+		if (found == m_stages.end())
+		{
+			m_stages.push_back({event.name});
+			found = m_stages.end() - 1;
+		}
+		found->calls++;
+		found->nanoseconds += event.duration_ns;
+	}
+}
+
+static void AppendMetric(std::string &out, const char *name, const char *type, const char *help)
+{
+	out += "# HELP ";
+	out += name;
+	out += ' ';
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += ' ';
+	out += type;
+	out += '\n';
+}
+
+// Label values escape backslashes, quotes and newlines
+static void AppendLabel(std::string &out, const char *value)
+{
+	for (const char *c = value; *c; ++c)
+	{
+		if (*c == '\\' || *c == '"')
+			out += '\\';
+		if (*c == '\n')
+			out += "\\n";
+		else
+			out += *c;
+	}
+}
+
+std::string MetricsServer::render()
+{
+	m_snapshots.update();
+	const MetricsSnapshot &snapshot = m_snapshots.read_buffer();
+	const EstimateStatistics &statistics = snapshot.statistics;
+
+	std::string out;
+	char line[256];
+	AppendMetric(out, "pi_samples_total", "counter", "Points thrown in the current run.");
+	snprintf(line, sizeof(line), "pi_samples_total %llu\n", (unsigned long long)snapshot.total_points);
+	out += line;
+	AppendMetric(out, "pi_inside_circle_total", "counter", "Points inside the unit circle in the current run.");
+	snprintf(line, sizeof(line), "pi_inside_circle_total %llu\n", (unsigned long long)snapshot.inside_circle);
+	out += line;
+	AppendMetric(out, "pi_estimate", "gauge", "Current estimate of pi, 4 * inside / total for plain sampling.");
+	snprintf(line, sizeof(line), "pi_estimate %.17g\n", statistics.estimate);
+	out += line;
+	AppendMetric(out, "pi_standard_error", "gauge", "Standard error of the estimate.");
+	snprintf(line, sizeof(line), "pi_standard_error %.17g\n", statistics.standard_error);
+	out += line;
+	AppendMetric(out, "pi_confidence_interval", "gauge", "Confidence interval of the estimate, Wilson for plain sampling.");
+	snprintf(line, sizeof(line), "pi_confidence_interval{confidence=\"%g\",bound=\"lower\"} %.17g\n", snapshot.confidence, statistics.lower);
+	out += line;
+	snprintf(line, sizeof(line), "pi_confidence_interval{confidence=\"%g\",bound=\"upper\"} %.17g\n", snapshot.confidence, statistics.upper);
+	out += line;
+	AppendMetric(out, "pi_samples_per_second", "gauge", "Sampling throughput, 0 while paused.");
+	snprintf(line, sizeof(line), "pi_samples_per_second %.6g\n", snapshot.samples_per_second);
+	out += line;
+	AppendMetric(out, "pi_running", "gauge", "1 while sampling, 0 while paused or stopped.");
+	snprintf(line, sizeof(line), "pi_running %d\n", snapshot.running ? 1 : 0);
+	out += line;
+	AppendMetric(out, "pi_accumulation_bytes", "gauge", "Memory of the accumulation grid and the worker buffers.");
+	snprintf(line, sizeof(line), "pi_accumulation_bytes %llu\n", (unsigned long long)snapshot.accumulation_bytes);
+	out += line;
+	AppendMetric(out, "pi_grid_size", "gauge", "Accumulation grid width in pixels, 0 when only counting.");
+	snprintf(line, sizeof(line), "pi_grid_size %u\n", snapshot.grid_size);
+	out += line;
+	AppendMetric(out, "pi_threads", "gauge", "Sampling threads.");
+	snprintf(line, sizeof(line), "pi_threads %u\n", snapshot.thread_count);
+	out += line;
+	AppendMetric(out, "pi_info", "gauge", "Run configuration.");
+	snprintf(line, sizeof(line), "pi_info{sampling_mode=\"%s\",sampling_strategy=\"%s\"} 1\n", sampling_mode_name(snapshot.sampling_mode),
+		sampling_strategy_name(snapshot.sampling_strategy));
+	out += line;
+
+	AppendMetric(out, "pi_stage_seconds_total", "counter", "Time spent in each profiled stage, while profiling is on.");
+	for (const StageTotals &stage : m_stages)
+	{
+		out += "pi_stage_seconds_total{stage=\"";
+		AppendLabel(out, stage.name);
+		snprintf(line, sizeof(line), "\"} %.9f\n", stage.nanoseconds / 1.0e9);
+		out += line;
+	}
+	AppendMetric(out, "pi_stage_calls_total", "counter", "Times each profiled stage ran.");
+	for (const StageTotals &stage : m_stages)
+	{
+		out += "pi_stage_calls_total{stage=\"";
+		AppendLabel(out, stage.name);
+		snprintf(line, sizeof(line), "\"} %llu\n", (unsigned long long)stage.calls);
+		out += line;
+	}
+	return out;
+}
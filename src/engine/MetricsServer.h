@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Profiler.h"
+#include "Sequence.h"
+#include "Statistics.h"
+#include "Strategy.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What a run reports to the metrics server
+struct MetricsSnapshot
+{
+	uint64_t total_points = 0;
+	uint64_t inside_circle = 0;
+	EstimateStatistics statistics; // At `confidence`, for the run's sampling strategy
+	double samples_per_second = 0.0;
+	double confidence = 0.95;
+	uint32_t grid_size = 0;
+	uint32_t thread_count = 0;
+	SamplingMode sampling_mode = SamplingMode::Pcg64;
+	SamplingStrategy sampling_strategy = SamplingStrategy::Plain;
+	uint64_t accumulation_bytes = 0;
+	bool running = true;
+};
+
+// Serves the newest MetricsSnapshot in the Prometheus text format, to any HTTP GET, from a
+// thread of its own. The run hands snapshots over through a triple buffer, so publishing
+// is a copy and a swap and a scrape never waits for the sampler or holds it up. Per-stage
+// timings come from the profiler's rings (see Profiler.h), which the server drains itself.
+class MetricsServer
+{
+public:
+	MetricsServer() = default;
+	~MetricsServer();
+
+	MetricsServer(const MetricsServer &) = delete;
+	MetricsServer &operator=(const MetricsServer &) = delete;
+
+	// "9464" listens on 127.0.0.1:9464, "host:port" on that address and "unix:<path>" on
+	// a Unix domain socket (not on Windows). Returns false if it cannot listen.
+	bool open(const char *address);
+	const std::string &address() const { return m_address; }
+
+	// Producer side, one thread: fill snapshot(), then publish() it
+	MetricsSnapshot &snapshot() { return m_snapshots.write_buffer(); }
+	void publish() { m_snapshots.publish(); }
+
+private:
+	struct StageTotals
+	{
+		const char *name;
+		uint64_t calls = 0;
+		uint64_t nanoseconds = 0;
+	};
+
+	void thread_loop();
+	void collect_stages();
+	std::string render();
+
+private:
+	// Bounds how long the thread takes to notice it should stop, and how many profiler
+	// events pile up between drains
+	static constexpr int s_poll_milliseconds = 200;
+	// Longest a client may take to send its request head
+	static constexpr int s_request_milliseconds = 1000;
+
+	std::string m_address;
+	std::string m_unix_path;
+	intptr_t m_socket = -1;
+	TripleBuffer<MetricsSnapshot> m_snapshots;
+
+	// Server thread only
+	ProfileCursor m_cursor;
+	std::vector<ProfileEvent> m_events;
+	std::vector<StageTotals> m_stages;
+
+	std::atomic<bool> m_stop = false;
+	std::thread m_thread;
+};
@@ -0,0 +1,225 @@
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct ProfileRing
+{
+	static constexpr uint64_t s_capacity = 1 << 14;
+
+	// Relaxed atomics: a reader may look at a slot while it is rewritten, and then
+	// discards it by re-reading head (see profile_collect)
+	struct Slot
+	{
+		std::atomic<const char *> name = nullptr;
+		std::atomic<uint64_t> start_ns = 0;
+		std::atomic<uint64_t> duration_ns = 0;
+	};
+
+	std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(s_capacity);
+	std::atomic<uint64_t> head = 0; // Events ever written; slot of event i is i % s_capacity
+	std::atomic<bool> in_use = true;
+	uint32_t index = 0;
+	std::string thread_name; // Guarded by the registry mutex
+};
+
+struct ProfileRegistry
+{
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ProfileRing>> rings;
+};
+
+static ProfileRegistry &Registry()
+{
+	static ProfileRegistry registry;
+	return registry;
+}
+
+// Hands the ring back when the thread exits, so pools that are recreated reuse rings
+struct ThreadRingOwner
+{
+	ProfileRing *ring = nullptr;
+
+	~ThreadRingOwner()
+	{
+		if (ring)
+			ring->in_use.store(false, std::memory_order_release);
+	}
+};
+
+static thread_local ThreadRingOwner s_thread_ring;
+static std::atomic<bool> s_enabled = true;
+
+static ProfileRing &ThreadRing()
+{
+	if (s_thread_ring.ring)
+		return *s_thread_ring.ring;
+
+	ProfileRegistry &registry = Registry();
+	std::lock_guard lock(registry.mutex);
+	for (std::unique_ptr<ProfileRing> &ring : registry.rings)
+	{
+		bool expected = false;
+		if (ring->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+		{
+			ring->thread_name.clear();
+			s_thread_ring.ring = ring.get();
+			return *ring;
+		}
+	}
+
+	registry.rings.push_back(std::make_unique<ProfileRing>());
+	registry.rings.back()->index = (uint32_t)registry.rings.size() - 1;
+	s_thread_ring.ring = registry.rings.back().get();
+	return *s_thread_ring.ring;
+}
+
+uint64_t profile_now()
+{
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void profile_record(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+	ProfileRing &ring = ThreadRing();
+	uint64_t head = ring.head.load(std::memory_order_relaxed);
+	ProfileRing::Slot &slot = ring.slots[head % ProfileRing::s_capacity];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start_ns.store(start_ns, std::memory_order_relaxed);
+	slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+void profile_set_enabled(bool enabled)
+{
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool profile_enabled()
+{
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+void profile_set_thread_name(const char *name)
+{
+	ProfileRing &ring = ThreadRing();
+	std::lock_guard lock(Registry().mutex);
+	ring.thread_name = name;
+}
+
+void profile_collect(ProfileCursor &cursor, std::vector<ProfileEvent> &events)
+{
+	ProfileRegistry &registry = Registry();
+	std::lock_guard lock(registry.mutex);
+	cursor.positions.resize(registry.rings.size(), 0);
+	for (size_t i = 0; i < registry.rings.size(); ++i)
+	{
+		ProfileRing &ring = *registry.rings[i];
+		uint64_t head = ring.head.load(std::memory_order_acquire);
+		uint64_t position = std::max(cursor.positions[i], head > ProfileRing::s_capacity ? head - ProfileRing::s_capacity : 0);
+
+		size_t first = events.size();
+		for (uint64_t event = position; event < head; ++event)
+		{
+			const ProfileRing::Slot &slot = ring.slots[event % ProfileRing::s_capacity];
+			events.push_back({slot.name.load(std::memory_order_relaxed), ring.index, slot.start_ns.load(std::memory_order_relaxed), slot.duration_ns.load(std::memory_order_relaxed)});
+		}
+
+		// Drop the slots the writer lapped while they were copied, including the one it may
+		// be writing now, event `lapped`, which has not advanced head yet
+		uint64_t lapped = ring.head.load(std::memory_order_acquire);
+		if (lapped + 1 > position + ProfileRing::s_capacity)
+		{
+			size_t stale = (size_t)std::min(lapped + 1 - ProfileRing::s_capacity - position, head - position);
+			events.erase(events.begin() + first, events.begin() + first + stale);
+		}
+		cursor.positions[i] = head;
+	}
+}
+
+static void WriteJsonString(FILE *file, const char *text)
+{
+	fputc('"', file);
+	for (const char *c = text; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool write_chrome_trace(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	ProfileCursor cursor;
+	std::vector<ProfileEvent> events;
+	profile_collect(cursor, events);
+
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool first = true;
+	{
+		ProfileRegistry &registry = Registry();
+		std::lock_guard lock(registry.mutex);
+		for (const std::unique_ptr<ProfileRing> &ring : registry.rings)
+		{
+			if (ring->thread_name.empty())
+				continue;
+			fprintf(file, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": ", first ? "" : ",\n", ring->index);
+			WriteJsonString(file, ring->thread_name.c_str());
+			fprintf(file, "}}");
+			first = false;
+		}
+	}
+	for (const ProfileEvent &event : events)
+	{
+		fprintf(file, "%s{\"ph\": \"X\", \"name\": ", first ? "" : ",\n");
+		WriteJsonString(file, event.name);
+		fprintf(file, ", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", event.thread, event.start_ns / 1000.0, event.duration_ns / 1000.0);
+		first = false;
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+float ProfileHistory::Stage::percentile(float fraction) const
+{
+	if (count == 0)
+		return 0.0f;
+
+	std::vector<float> sorted(milliseconds.begin(), milliseconds.begin() + count);
+	size_t rank = std::min<size_t>(count - 1, (size_t)(fraction * (float)count));
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+void ProfileHistory::update()
+{
+	m_events.clear();
+	profile_collect(m_cursor, m_events);
+	for (const ProfileEvent &event : m_events)
+	{
+		// A handful of stages, and the same literal can have different addresses per module
+		auto found = std::ranges::find_if(m_stages, [&](const Stage &stage) { return strcmp(stage.name, event.name) == 0; });
+		if (found == m_stages.end())
+		{
+			m_stages.push_back({event.name, std::vector<float>(s_history_size, 0.0f)});
+			found = m_stages.end() - 1;
+		}
+
+		found->milliseconds[found->next] = (float)(event.duration_ns / 1.0e6);
+		found->next = (found->next + 1) % s_history_size;
+		found->count = std::min(found->count + 1, s_history_size);
+	}
+}
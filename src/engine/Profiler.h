@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Scoped timers for the hot paths. Every thread records into its own fixed-size ring, so
+// a scope costs two clock reads and a few relaxed stores and readers never block writers.
+// Event names must be string literals (or otherwise outlive the process).
+
+struct ProfileEvent
+{
+	const char *name;
+	uint32_t thread;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+// Read position in every thread's ring, see profile_collect()
+struct ProfileCursor
+{
+	std::vector<uint64_t> positions;
+};
+
+// Nanoseconds since the first call, on a monotonic clock
+uint64_t profile_now();
+void profile_record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+void profile_set_enabled(bool enabled);
+bool profile_enabled();
+
+// Names the calling thread in traces; the name is copied
+void profile_set_thread_name(const char *name);
+
+// Appends the events recorded since the cursor's previous call. Events that a ring
+// overwrote before they were read are skipped.
+void profile_collect(ProfileCursor &cursor, std::vector<ProfileEvent> &events);
+
+// Writes every event still in the rings as Chrome trace event JSON, which chrome://tracing
+// and ui.perfetto.dev open directly
+bool write_chrome_trace(const char *path);
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char *name)
+		: m_name(name), m_enabled(profile_enabled())
+	{
+		if (m_enabled)
+			m_start = profile_now();
+	}
+
+	~ProfileScope()
+	{
+		stop();
+	}
+
+	// Ends the scope early, for phases that do not line up with a block
+	void stop()
+	{
+		if (m_enabled)
+			profile_record(m_name, m_start, profile_now());
+		m_enabled = false;
+	}
+
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+	const char *m_name;
+	bool m_enabled;
+	uint64_t m_start = 0;
+};
+
+// Rolling durations per event name, for frame-time graphs and percentiles
+class ProfileHistory
+{
+public:
+	static constexpr uint32_t s_history_size = 240;
+
+	struct Stage
+	{
+		const char *name = nullptr;
+		// Ring of the last s_history_size durations; the oldest is at `next` once full
+		std::vector<float> milliseconds;
+		uint32_t next = 0;
+		uint32_t count = 0;
+
+		// fraction in [0, 1], e.g. 0.95 for p95
+		float percentile(float fraction) const;
+	};
+
+	// Pulls the events recorded since the previous call
+	void update();
+	const std::vector<Stage> &stages() const { return m_stages; }
+
+private:
+	ProfileCursor m_cursor;
+	std::vector<ProfileEvent> m_events;
+	std::vector<Stage> m_stages;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+// 32-bit LCG that drives the PCG-style hash below
+inline uint32_t random_step(uint32_t state)
+{
+	return state * 747796405 + 2891336453;
+}
+
+inline uint32_t random_hash(uint32_t state)
+{
+	uint32_t result = ((state >> ((state >> 28) + 4)) ^ state) * 277803737;
+	return (result >> 22) ^ result;
+}
+
+// Advances the 32-bit LCG state and returns the 32 hashed bits random_float() scales
+inline uint32_t random_bits(uint32_t &state)
+{
+	state = random_step(state);
+	return random_hash(state);
+}
+
+// PCG-style hash: advances the 32-bit LCG state and returns a float in [0, 1]
+inline float random_float(uint32_t &state)
+{
+	return ((float)random_bits(state) / 4294967295.0f);
+}
+
+// Affine map equivalent to applying random_step() a fixed number of times
+struct RandomJump
+{
+	uint32_t multiplier = 1;
+	uint32_t increment = 0;
+};
+
+// Composes the LCG with itself `draws` times in O(log draws) (Brown's skip-ahead)
+inline RandomJump random_jump(uint64_t draws)
+{
+	uint32_t multiplier = 747796405;
+	uint32_t increment = 2891336453;
+	RandomJump jump;
+	while (draws > 0)
+	{
+		if (draws & 1)
+		{
+			jump.multiplier *= multiplier;
+			jump.increment = jump.increment * multiplier + increment;
+		}
+		increment = (multiplier + 1) * increment;
+		multiplier *= multiplier;
+		draws >>= 1;
+	}
+	return jump;
+}
+
+// Returns the state random_float would reach after `draws` calls.
+// Lets each worker jump straight to its own slice of one global sequence.
+inline uint32_t random_advance(uint32_t state, uint64_t draws)
+{
+	RandomJump jump = random_jump(draws);
+	return jump.multiplier * state + jump.increment;
+}
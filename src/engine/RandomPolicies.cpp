@@ -0,0 +1,145 @@
+#include "RandomPolicies.h"
+
+#include <array>
+
+using Polynomial = std::array<uint64_t, 4>; // Degree < 256 over GF(2), bit i is x^i
+
+// The minimal polynomial of the transition, x^256 + `low`, found by Berlekamp-Massey on
+// the lowest output bit, which is linear in the state. Its degree is 256 since the period
+// is 2^256 - 1.
+static Polynomial CharacteristicPolynomial()
+{
+	constexpr uint32_t bits = 512;
+	std::array<uint8_t, bits> sequence;
+	Xoshiro256Plus generator(0);
+	for (uint8_t &bit : sequence)
+		bit = (uint8_t)(generator.next() & 1); // s0 ^ s3 in the lowest bit, a linear function
+
+	std::array<uint8_t, bits + 1> connection = {1};
+	std::array<uint8_t, bits + 1> previous = {1};
+	uint32_t length = 0;
+	uint32_t shift = 1;
+	for (uint32_t n = 0; n < bits; ++n)
+	{
+		uint8_t discrepancy = sequence[n];
+		for (uint32_t i = 1; i <= length; ++i)
+			discrepancy ^= connection[i] & sequence[n - i];
+		if (!discrepancy)
+		{
+			shift++;
+			continue;
+		}
+
+		std::array<uint8_t, bits + 1> saved = connection;
+		for (uint32_t i = 0; i + shift <= bits; ++i)
+			connection[i + shift] ^= previous[i];
+		if (2 * length <= n)
+		{
+			length = n + 1 - length;
+			previous = saved;
+			shift = 1;
+		}
+		else
+		{
+			shift++;
+		}
+	}
+
+	// x^L C(1/x), without its leading x^256
+	Polynomial low = {};
+	for (uint32_t i = 1; i <= length; ++i)
+	{
+		if (connection[i])
+			low[(length - i) / 64] |= 1ull << ((length - i) % 64);
+	}
+	return low;
+}
+
+// a^2 modulo x^256 + `low`; squaring over GF(2) spreads bit i to bit 2i
+static Polynomial SquareModulo(const Polynomial &a, const Polynomial &low)
+{
+	std::array<uint64_t, 8> square = {};
+	for (uint32_t bit = 0; bit < 256; ++bit)
+	{
+		if (a[bit / 64] >> (bit % 64) & 1)
+			square[bit / 32] |= 1ull << (2 * bit % 64);
+	}
+
+	// x^d = x^(d - 256) * low for every d >= 256, from the top down
+	for (uint32_t degree = 511; degree >= 256; --degree)
+	{
+		if (!(square[degree / 64] >> (degree % 64) & 1))
+			continue;
+		square[degree / 64] ^= 1ull << (degree % 64);
+		uint32_t offset = degree - 256;
+		for (uint32_t bit = 0; bit < 256; ++bit)
+		{
+			if (low[bit / 64] >> (bit % 64) & 1)
+				square[(bit + offset) / 64] ^= 1ull << ((bit + offset) % 64);
+		}
+	}
+	return {square[0], square[1], square[2], square[3]};
+}
+
+struct JumpTable
+{
+	std::array<Polynomial, 64> polynomials;
+
+	JumpTable()
+	{
+		Polynomial low = CharacteristicPolynomial();
+		Polynomial power = {2, 0, 0, 0}; // x
+		for (Polynomial &polynomial : polynomials)
+		{
+			polynomial = power;
+			power = SquareModulo(power, low);
+		}
+	}
+};
+
+static const JumpTable &Jumps()
+{
+	static const JumpTable table;
+	return table;
+}
+
+const uint64_t *Xoshiro256Plus::jump_polynomial(uint32_t k)
+{
+	return Jumps().polynomials[k].data();
+}
+
+void Xoshiro256Plus::discard(uint64_t count)
+{
+	// A jump costs 256 steps
+	if (count < 1024)
+	{
+		for (; count > 0; --count)
+			step();
+		return;
+	}
+	for (uint32_t k = 0; count > 0; ++k, count >>= 1)
+	{
+		if (count & 1)
+			apply_jump(jump_polynomial(k));
+	}
+}
+
+void Xoshiro256Plus::apply_jump(const uint64_t *polynomial)
+{
+	// The state after the jump is sum(c_i T^i s) for the polynomial's coefficients c_i
+	uint64_t jumped[4] = {};
+	for (uint32_t word = 0; word < 4; ++word)
+	{
+		for (uint32_t bit = 0; bit < 64; ++bit)
+		{
+			if (polynomial[word] >> bit & 1)
+			{
+				for (uint32_t i = 0; i < 4; ++i)
+					jumped[i] ^= m_state[i];
+			}
+			step();
+		}
+	}
+	for (uint32_t i = 0; i < 4; ++i)
+		m_state[i] = jumped[i];
+}
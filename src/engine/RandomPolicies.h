@@ -0,0 +1,210 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// 64-bit generators behind the pseudo-random sampling modes of Sequence.h. They share one
+// shape, so the point generators are templates over them with no indirect call per draw:
+// constructed from a seed, next() returns 64 random bits and discard(n) skips n of them
+// without generating them, so any range of draws can be produced on its own.
+
+inline uint64_t splitmix64(uint64_t &state)
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 NativeUint128;
+#endif
+
+struct Uint128
+{
+	uint64_t low = 0;
+	uint64_t high = 0;
+};
+
+inline Uint128 uint128_add(Uint128 a, Uint128 b)
+{
+	uint64_t low = a.low + b.low;
+	return {low, a.high + b.high + (low < a.low)};
+}
+
+// Product modulo 2^128
+inline Uint128 uint128_multiply(Uint128 a, Uint128 b)
+{
+	Uint128 product;
+#if defined(__SIZEOF_INT128__)
+	NativeUint128 low_product = (NativeUint128)a.low * b.low;
+	product.low = (uint64_t)low_product;
+	product.high = (uint64_t)(low_product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	product.low = _umul128(a.low, b.low, &product.high);
+#else
+	uint64_t a_low = (uint32_t)a.low, a_high = a.low >> 32;
+	uint64_t b_low = (uint32_t)b.low, b_high = b.low >> 32;
+	uint64_t cross = (a_low * b_low >> 32) + (uint32_t)(a_high * b_low) + (uint32_t)(a_low * b_high);
+	product.low = a.low * b.low;
+	product.high = a_high * b_high + (a_high * b_low >> 32) + (a_low * b_high >> 32) + (cross >> 32);
+#endif
+	product.high += a.low * b.high + a.high * b.low;
+	return product;
+}
+
+// PCG64 (XSL RR 128/64): a 128-bit LCG with a permuted output. discard() composes the LCG
+// with itself in O(log n) like random_jump().
+class Pcg64
+{
+public:
+	explicit Pcg64(uint32_t seed)
+	{
+		uint64_t mix = seed;
+		m_state = {splitmix64(mix), splitmix64(mix)};
+		m_increment = {splitmix64(mix) | 1, splitmix64(mix)};
+	}
+
+	uint64_t next()
+	{
+		m_state = uint128_add(uint128_multiply(m_state, s_multiplier), m_increment);
+		return std::rotr(m_state.high ^ m_state.low, (int)(m_state.high >> 58));
+	}
+
+	void discard(uint64_t count)
+	{
+		Uint128 multiplier = s_multiplier;
+		Uint128 increment = m_increment;
+		Uint128 jump_multiplier = {1, 0};
+		Uint128 jump_increment = {0, 0};
+		for (; count > 0; count >>= 1)
+		{
+			if (count & 1)
+			{
+				jump_multiplier = uint128_multiply(jump_multiplier, multiplier);
+				jump_increment = uint128_add(uint128_multiply(jump_increment, multiplier), increment);
+			}
+			increment = uint128_multiply(uint128_add(multiplier, {1, 0}), increment);
+			multiplier = uint128_multiply(multiplier, multiplier);
+		}
+		m_state = uint128_add(uint128_multiply(jump_multiplier, m_state), jump_increment);
+	}
+
+private:
+	static constexpr Uint128 s_multiplier = {0x4385df649fccf645ull, 0x2360ed051fc65da4ull};
+
+	Uint128 m_state;
+	Uint128 m_increment;
+};
+
+// xoshiro256+, the fastest of the family; only the top 53 bits are used, its low bits are
+// weak. The state transition is linear over GF(2), so skipping 2^k draws is a fixed
+// polynomial in it: discard() applies one per set bit of n, 256 steps each.
+class Xoshiro256Plus
+{
+public:
+	explicit Xoshiro256Plus(uint32_t seed)
+	{
+		uint64_t mix = seed;
+		for (uint64_t &word : m_state)
+			word = splitmix64(mix);
+	}
+
+	uint64_t next()
+	{
+		uint64_t result = m_state[0] + m_state[3];
+		step();
+		return result;
+	}
+
+	void discard(uint64_t count);
+
+	// Coefficients of x^(2^k) modulo the transition's characteristic polynomial, k < 64
+	static const uint64_t *jump_polynomial(uint32_t k);
+
+private:
+	void step()
+	{
+		uint64_t shifted = m_state[1] << 17;
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= shifted;
+		m_state[3] = std::rotl(m_state[3], 45);
+	}
+
+	void apply_jump(const uint64_t *polynomial);
+
+	uint64_t m_state[4];
+};
+
+// Philox4x32-10 (Salmon et al.), counter-based: block i is ten rounds of a keyed bijection
+// applied to i, so skipping is O(1) and every block can be computed independently.
+class Philox4x32
+{
+public:
+	// The key is the seed and s_key_high; count_inside_philox_batch() in SimdKernel.cpp runs
+	// the same rounds for many keys at once
+	static constexpr uint32_t s_key_high = 0x5eed5eedu;
+	static constexpr uint32_t s_multiplier0 = 0xd2511f53u;
+	static constexpr uint32_t s_multiplier1 = 0xcd9e8d57u;
+	static constexpr uint32_t s_key_step0 = 0x9e3779b9u;
+	static constexpr uint32_t s_key_step1 = 0xbb67ae85u;
+	static constexpr int s_rounds = 10;
+
+	explicit Philox4x32(uint32_t seed)
+		: m_key{seed, s_key_high}
+	{
+	}
+
+	uint64_t next()
+	{
+		uint64_t counter = m_position >> 1;
+		if (counter != m_block_counter)
+		{
+			block(counter, m_block);
+			m_block_counter = counter;
+		}
+		return m_block[m_position++ & 1];
+	}
+
+	void discard(uint64_t count) { m_position += count; }
+
+	// The 128 bits of block `counter`
+	void block(uint64_t counter, uint64_t output[2]) const
+	{
+		uint32_t words[4] = {(uint32_t)counter, (uint32_t)(counter >> 32), 0, 0};
+		uint32_t key[2] = {m_key[0], m_key[1]};
+		for (int round = 0; round < s_rounds; ++round)
+		{
+			if (round > 0)
+			{
+				key[0] += s_key_step0;
+				key[1] += s_key_step1;
+			}
+			uint64_t product0 = (uint64_t)s_multiplier0 * words[0];
+			uint64_t product1 = (uint64_t)s_multiplier1 * words[2];
+			uint32_t next_words[4] = {
+				(uint32_t)(product1 >> 32) ^ words[1] ^ key[0],
+				(uint32_t)product1,
+				(uint32_t)(product0 >> 32) ^ words[3] ^ key[1],
+				(uint32_t)product0,
+			};
+			for (int i = 0; i < 4; ++i)
+				words[i] = next_words[i];
+		}
+		output[0] = words[0] | ((uint64_t)words[1] << 32);
+		output[1] = words[2] | ((uint64_t)words[3] << 32);
+	}
+
+private:
+	uint32_t m_key[2];
+	uint64_t m_position = 0;
+	uint64_t m_block_counter = UINT64_MAX;
+	uint64_t m_block[2] = {};
+};
@@ -0,0 +1,714 @@
+#include "Sampler.h"
+#include "Profiler.h"
+#include "SimdKernel.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <bit>
+
+Sampler::Sampler(uint32_t size, uint32_t thread_count, uint32_t seed)
+	: m_seed(seed)
+{
+	set_thread_count(thread_count);
+	reset(size);
+}
+
+Sampler::~Sampler() = default;
+
+void Sampler::sample(uint64_t count)
+{
+	uint64_t max_batch = s_max_samples_per_worker * thread_count();
+	while (count > 0)
+	{
+		uint64_t batch = std::min(count, max_batch);
+		sample_batch(batch);
+		count -= batch;
+	}
+}
+
+void Sampler::sample_batch(uint64_t count)
+{
+	ProfileScope scope("Sample");
+
+	// Private buffers cost a merge of the whole grid per extra worker, binning only a pass
+	// over the samples
+	bool binned = m_grid_size > 0 && use_bins();
+	uint64_t min_samples = binned ? s_min_samples_per_worker : std::max<uint64_t>(s_min_samples_per_worker, (uint64_t)m_grid_size * m_grid_size);
+	uint32_t worker_count = (uint32_t)std::clamp<uint64_t>(count / min_samples, 1, thread_count());
+
+	m_version++;
+	if (worker_count == 1)
+	{
+		SampleCounts counts = accumulate(m_next_sample, count, m_accumulation);
+		m_inside_circle += counts.inside_circle;
+		m_inside_pairs += counts.inside_pairs;
+		stamp_touched_tiles();
+	}
+	else if (binned)
+	{
+		sample_binned(count, worker_count);
+	}
+	else
+	{
+		sample_private(count, worker_count);
+	}
+	stamp_display_tiles();
+
+	m_next_sample += count;
+	m_total_points += count;
+}
+
+void Sampler::sample_private(uint64_t count, uint32_t worker_count)
+{
+	if (m_worker_accumulation.size() < worker_count)
+		m_worker_accumulation.resize(worker_count);
+
+	std::vector<SampleCounts> counts(worker_count);
+	uint64_t chunk = count / worker_count;
+	m_pool->run(worker_count, [&](uint32_t worker) {
+		ProfileScope scope("Accumulate");
+		AccumulationBuffers<uint32_t> &buffers = m_worker_accumulation[worker];
+		if (buffers.touched_tiles.size() != m_tile_versions.size())
+			buffers.assign(m_tile_versions.size());
+
+		uint64_t first = chunk * worker;
+		uint64_t worker_samples = worker + 1 == worker_count ? count - first : chunk;
+		counts[worker] = accumulate(m_next_sample + first, worker_samples, buffers);
+	});
+	merge(worker_count);
+
+	for (const SampleCounts &worker_counts : counts)
+	{
+		m_inside_circle += worker_counts.inside_circle;
+		m_inside_pairs += worker_counts.inside_pairs;
+	}
+}
+
+void Sampler::sample_binned(uint64_t count, uint32_t worker_count)
+{
+	if (m_worker_bins.size() < worker_count)
+		m_worker_bins.resize(worker_count);
+
+	// Each round every worker bins one block of its slice, then each worker accumulates the
+	// bins of its own range of tiles from all blocks, so no two workers write the same cell
+	std::vector<SampleCounts> counts(worker_count);
+	uint64_t chunk = count / worker_count;
+	uint64_t last_worker_samples = count - chunk * (worker_count - 1);
+	uint32_t bins_per_worker = (bin_count() + worker_count - 1) / worker_count;
+	for (uint64_t offset = 0; offset < last_worker_samples; offset += s_bin_block_size)
+	{
+		m_pool->run(worker_count, [&](uint32_t worker) {
+			ProfileScope scope("Bin");
+			uint64_t first = chunk * worker;
+			uint64_t worker_samples = worker + 1 == worker_count ? count - first : chunk;
+			uint64_t block = offset < worker_samples ? std::min<uint64_t>(s_bin_block_size, worker_samples - offset) : 0;
+			SampleCounts binned_counts = bin_samples(m_next_sample + first + offset, (uint32_t)block, m_worker_bins[worker]);
+			counts[worker].inside_circle += binned_counts.inside_circle;
+			counts[worker].inside_pairs += binned_counts.inside_pairs;
+		});
+		m_pool->run(worker_count, [&](uint32_t worker) {
+			ProfileScope scope("Accumulate bins");
+			uint32_t bin_begin = std::min(bin_count(), bins_per_worker * worker);
+			uint32_t bin_end = std::min(bin_count(), bin_begin + bins_per_worker);
+			accumulate_bins(bin_begin, bin_end, worker_count);
+		});
+	}
+	stamp_touched_tiles();
+
+	for (const SampleCounts &worker_counts : counts)
+	{
+		m_inside_circle += worker_counts.inside_circle;
+		m_inside_pairs += worker_counts.inside_pairs;
+	}
+}
+
+Sampler::SampleCounts Sampler::bin_samples(uint64_t first_sample, uint32_t count, SampleBins &bins) const
+{
+	uint32_t bins_total = bin_count();
+	bins.offsets.assign(bins_total + 1, 0);
+	if (count == 0)
+		return {};
+
+	bins.cell_indices.resize(s_bin_block_size);
+	bins.inside.resize(s_bin_block_size);
+	bins.entries.resize(s_bin_block_size);
+	SampleCounts counts;
+	counts.inside_pairs = classify(first_sample, count, bins.cell_indices.data(), bins.inside.data());
+
+	// Counting sort: histogram, exclusive prefix sum, then place
+	for (uint32_t i = 0; i < count; ++i)
+		bins.offsets[(bins.cell_indices[i] >> s_bin_cell_shift) + 1]++;
+	for (uint32_t bin = 0; bin < bins_total; ++bin)
+		bins.offsets[bin + 1] += bins.offsets[bin];
+
+	bins.cursors.assign(bins.offsets.begin(), bins.offsets.end() - 1);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t cell_index = bins.cell_indices[i];
+		bins.entries[bins.cursors[cell_index >> s_bin_cell_shift]++] = (cell_index & (s_bin_cells - 1)) | (bins.inside[i] << 31);
+		counts.inside_circle += bins.inside[i];
+	}
+	return counts;
+}
+
+void Sampler::accumulate_bins(uint32_t bin_begin, uint32_t bin_end, uint32_t worker_count)
+{
+	for (uint32_t bin = bin_begin; bin < bin_end; ++bin)
+	{
+		PixelCounts<uint64_t> *cells = m_accumulation.cells.data() + ((size_t)bin << s_bin_cell_shift);
+		uint8_t *touched_tiles = m_accumulation.touched_tiles.data() + ((size_t)bin << (s_bin_cell_shift - GridLayout::s_tile_cell_shift));
+		for (uint32_t worker = 0; worker < worker_count; ++worker)
+		{
+			const SampleBins &bins = m_worker_bins[worker];
+			for (uint32_t i = bins.offsets[bin]; i < bins.offsets[bin + 1]; ++i)
+			{
+				uint32_t entry = bins.entries[i];
+				uint32_t cell = entry & (s_bin_cells - 1);
+				cells[cell].total++;
+				cells[cell].inside += entry >> 31;
+				touched_tiles[GridLayout::tile_of(cell)] = 1;
+			}
+		}
+	}
+}
+
+void Sampler::reset(uint32_t size)
+{
+	if (!supports_size(m_strategy, size))
+		m_strategy = SamplingStrategy::Plain;
+	size_t tiles_per_row = GridLayout::tiles_per_row(grid_width(m_strategy, size));
+	set_grid(size, std::vector<PixelCounts<uint64_t>>(tiles_per_row * tiles_per_row * GridLayout::s_tile_cells));
+	m_total_points = 0;
+	m_inside_circle = 0;
+	m_inside_pairs = 0;
+
+	// A low-discrepancy sequence is most uniform from its first point on
+	if (is_low_discrepancy(m_mode))
+		m_next_sample = 0;
+	// Antithetic pairs start at even samples
+	if (m_strategy == SamplingStrategy::Antithetic)
+		m_next_sample &= ~1ull;
+}
+
+void Sampler::set_grid(uint32_t size, std::vector<PixelCounts<uint64_t>> cells)
+{
+	m_size = size;
+	m_grid_size = grid_width(m_strategy, size);
+	m_tiles_per_row = GridLayout::tiles_per_row(m_grid_size);
+	m_strata = {};
+	if (is_stratified(m_strategy))
+		m_strata.build(m_strategy, m_grid_size);
+
+	size_t tile_count = (size_t)m_tiles_per_row * m_tiles_per_row;
+	m_accumulation.cells = std::move(cells);
+	m_accumulation.touched_tiles.assign(tile_count, 0);
+	m_worker_accumulation.clear();
+	m_worker_bins.clear();
+	m_levels.clear();
+
+	// Every tile has new contents
+	m_version++;
+	m_tile_versions.assign(tile_count, m_version);
+	if (!can_display(m_size, m_display_size, m_strategy))
+		m_display_size = m_size;
+	stamp_display_tiles();
+}
+
+bool Sampler::can_display(uint32_t grid_size, uint32_t size, SamplingStrategy strategy)
+{
+	// A folded image needs a pixel per quadrant
+	if (is_folded(strategy) && size == 1)
+		return false;
+	return size == grid_size || (size > 0 && size < grid_size && std::has_single_bit(size) && std::has_single_bit(grid_size));
+}
+
+bool Sampler::set_display_size(uint32_t size)
+{
+	if (!can_display(m_size, size, m_strategy))
+		return false;
+	// The counts stay the same, callers resolve a new display size from scratch
+	m_display_size = size;
+	m_version++;
+	stamp_display_tiles();
+	return true;
+}
+
+void Sampler::grid_span(uint32_t begin, uint32_t end, uint32_t &grid_begin, uint32_t &grid_end) const
+{
+	// Image pixels [begin, end) along one axis; a folded grid holds the right half, and
+	// the left half mirrored, so a span across the middle covers both sides of the fold
+	uint32_t half = m_grid_size;
+	if (!is_folded(m_strategy) || begin >= half)
+	{
+		grid_begin = begin - (is_folded(m_strategy) ? half : 0);
+		grid_end = end - (is_folded(m_strategy) ? half : 0);
+	}
+	else if (end <= half)
+	{
+		grid_begin = half - end;
+		grid_end = half - begin;
+	}
+	else
+	{
+		grid_begin = 0;
+		grid_end = std::max(half - begin, end - half);
+	}
+}
+
+void Sampler::stamp_display_tiles()
+{
+	if (display_is_grid())
+		return;
+
+	// Each display tile takes the newest version of the grid tiles under it
+	uint32_t ratio = m_size / std::max(m_display_size, 1u);
+	uint32_t display_tiles_per_row = GridLayout::tiles_per_row(m_display_size);
+	m_display_tile_versions.assign((size_t)display_tiles_per_row * display_tiles_per_row, 0);
+	for (uint32_t display_tile = 0; display_tile < m_display_tile_versions.size(); ++display_tile)
+	{
+		uint32_t x_begin = (display_tile % display_tiles_per_row) * s_tile_size;
+		uint32_t y_begin = (display_tile / display_tiles_per_row) * s_tile_size;
+		uint32_t grid_x_begin, grid_x_end, grid_y_begin, grid_y_end;
+		grid_span(x_begin * ratio, std::min(m_display_size, x_begin + s_tile_size) * ratio, grid_x_begin, grid_x_end);
+		grid_span(y_begin * ratio, std::min(m_display_size, y_begin + s_tile_size) * ratio, grid_y_begin, grid_y_end);
+
+		uint64_t &version = m_display_tile_versions[display_tile];
+		for (uint32_t tile_y = grid_y_begin / s_tile_size; tile_y <= (grid_y_end - 1) / s_tile_size; ++tile_y)
+		{
+			for (uint32_t tile_x = grid_x_begin / s_tile_size; tile_x <= (grid_x_end - 1) / s_tile_size; ++tile_x)
+				version = std::max(version, m_tile_versions[(size_t)tile_y * m_tiles_per_row + tile_x]);
+		}
+	}
+}
+
+void Sampler::save(SamplerState &state) const
+{
+	state.size = m_size;
+	state.seed = m_seed;
+	state.mode = m_mode;
+	state.strategy = m_strategy;
+	state.next_sample = m_next_sample;
+	state.total_points = m_total_points;
+	state.inside_circle = m_inside_circle;
+	state.inside_pairs = m_inside_pairs;
+	state.cells.assign(m_accumulation.cells.begin(), m_accumulation.cells.end());
+}
+
+bool Sampler::restore(SamplerState &&state)
+{
+	if (state.strategy >= SamplingStrategy::Count || !supports_size(state.strategy, state.size))
+		return false;
+	size_t tiles_per_row = GridLayout::tiles_per_row(grid_width(state.strategy, state.size));
+	if (state.cells.size() != tiles_per_row * tiles_per_row * GridLayout::s_tile_cells || state.inside_circle > state.total_points ||
+		state.inside_pairs > state.inside_circle / 2 || state.mode >= SamplingMode::Count)
+		return false;
+
+	m_strategy = state.strategy;
+	set_grid(state.size, std::move(state.cells));
+	m_seed = state.seed;
+	m_mode = state.mode;
+	m_next_sample = state.next_sample;
+	m_total_points = state.total_points;
+	m_inside_circle = state.inside_circle;
+	m_inside_pairs = state.inside_pairs;
+	return true;
+}
+
+void Sampler::set_colors(Color inside, Color outside)
+{
+	m_inside_color = inside;
+	m_outside_color = outside;
+}
+
+void Sampler::set_thread_count(uint32_t thread_count)
+{
+	thread_count = std::max(thread_count, 1u);
+	if (m_pool && m_pool->thread_count() == thread_count)
+		return;
+
+	m_pool = std::make_unique<WorkerPool>(thread_count);
+	m_worker_accumulation.clear();
+	m_worker_bins.clear();
+}
+
+void Sampler::set_sampling_mode(SamplingMode mode)
+{
+	m_mode = mode;
+	reset(m_size);
+}
+
+bool Sampler::set_sampling_strategy(SamplingStrategy strategy)
+{
+	if (!supports_size(strategy, m_size))
+		return false;
+	m_strategy = strategy;
+	reset(m_size);
+	return true;
+}
+
+EstimateStatistics Sampler::statistics(double z) const
+{
+	switch (m_strategy)
+	{
+	case SamplingStrategy::Antithetic:
+		return antithetic_statistics(m_inside_circle, m_inside_pairs, m_total_points, z);
+	case SamplingStrategy::Stratified:
+	case SamplingStrategy::BoundaryBand:
+		return stratified_statistics(z);
+	default:
+		return estimate_statistics(m_inside_circle, m_total_points, z);
+	}
+}
+
+EstimateStatistics Sampler::stratified_statistics(double z) const
+{
+	// Areas in pixels of the folded grid; pixels inside the circle always count fully
+	double pixels = (double)m_grid_size * m_grid_size;
+	double inside_pixels = (double)m_strata.inside_pixels();
+	if (m_total_points < m_strata.count())
+	{
+		// Until every stratum has a sample the sampled ones are a plain sample of the strata,
+		// whose share of the quarter circle is scaled by the strata's area
+		EstimateStatistics statistics = estimate_statistics(m_inside_circle, m_total_points, z);
+		if (m_strategy == SamplingStrategy::Stratified)
+			return statistics;
+		double band = (double)m_strata.count() / pixels;
+		statistics.estimate = 4.0 * inside_pixels / pixels + band * statistics.estimate;
+		statistics.lower = 4.0 * inside_pixels / pixels + band * statistics.lower;
+		statistics.upper = 4.0 * inside_pixels / pixels + band * statistics.upper;
+		statistics.half_width *= band;
+		statistics.standard_error *= band;
+		statistics.variance *= band * band;
+		return statistics;
+	}
+
+	// The edge pixels are the only strata whose inside fraction is not known exactly; the
+	// (k + 1) / (n + 2) fraction keeps a stratum with few samples from claiming no variance
+	double covered = inside_pixels;
+	double variance = 0.0;
+	for (uint32_t cell : m_strata.edge_cells())
+	{
+		const PixelCounts<uint64_t> &counts = m_accumulation.cells[cell];
+		double n = (double)counts.total;
+		double p = ((double)counts.inside + 1.0) / (n + 2.0);
+		covered += (double)counts.inside / n;
+		variance += p * (1.0 - p) / n;
+	}
+	return normal_statistics(4.0 * covered / pixels, 16.0 * variance / (pixels * pixels), z);
+}
+
+uint64_t Sampler::samples_for_precision(double epsilon, double z) const
+{
+	if (m_strategy == SamplingStrategy::Plain || m_total_points == 0)
+		return ::samples_for_precision(m_inside_circle, m_total_points, epsilon, z);
+
+	// Every stratum needs a sample before the interval is the stratified one
+	return std::max<uint64_t>(::samples_for_precision(statistics(z), m_total_points, epsilon), m_strata.count());
+}
+
+uint32_t Sampler::thread_count() const
+{
+	return m_pool->thread_count();
+}
+
+template <typename Count>
+static uint64_t BufferBytes(const AccumulationBuffers<Count> &buffers)
+{
+	return buffers.cells.capacity() * sizeof(PixelCounts<Count>) + buffers.touched_tiles.capacity();
+}
+
+uint64_t Sampler::accumulation_bytes() const
+{
+	uint64_t bytes = BufferBytes(m_accumulation);
+	for (const CountLevel &level : m_levels)
+		bytes += level.cells.capacity() * sizeof(PixelCounts<uint64_t>);
+	for (const AccumulationBuffers<uint32_t> &buffers : m_worker_accumulation)
+		bytes += BufferBytes(buffers);
+	for (const SampleBins &bins : m_worker_bins)
+	{
+		bytes += (bins.entries.capacity() + bins.offsets.capacity() + bins.cursors.capacity() + bins.cell_indices.capacity() +
+			bins.inside.capacity()) * sizeof(uint32_t);
+	}
+	return bytes;
+}
+
+void Sampler::touch_all_tiles()
+{
+	m_version++;
+	std::ranges::fill(m_tile_versions, m_version);
+	stamp_display_tiles();
+}
+
+uint32_t Sampler::resolve_color(const PixelCounts<uint64_t> &counts) const
+{
+	if (counts.total == 0)
+		return ToColor(0, 0, 0, 255); // Black for no samples
+
+	// Average of the inside and outside colors, weighted by their sample counts
+	uint64_t inside = counts.inside;
+	uint64_t outside = counts.total - counts.inside;
+	uint8_t final_r = (uint8_t)((inside * m_inside_color.r + outside * m_outside_color.r) / counts.total);
+	uint8_t final_g = (uint8_t)((inside * m_inside_color.g + outside * m_outside_color.g) / counts.total);
+	uint8_t final_b = (uint8_t)((inside * m_inside_color.b + outside * m_outside_color.b) / counts.total);
+	return ToColor(final_r, final_g, final_b, 255);
+}
+
+PixelCounts<uint64_t> Sampler::grid_counts(uint32_t x, uint32_t y) const
+{
+	const PixelCounts<uint64_t> &counts = m_accumulation.cells[GridLayout::cell_index(x, y, m_tiles_per_row)];
+	if (m_strategy != SamplingStrategy::BoundaryBand)
+		return counts;
+
+	// The band only samples the edge pixels, the others are entirely inside or outside;
+	// every pixel that is known weighs the same
+	PixelClass pixel_class = classify_pixel(x, y, m_grid_size);
+	if (pixel_class == PixelClass::Inside)
+		return {s_band_pixel_weight, s_band_pixel_weight};
+	if (pixel_class == PixelClass::Outside)
+		return {0, s_band_pixel_weight};
+	if (counts.total == 0)
+		return {};
+	return {(uint64_t)((double)counts.inside / (double)counts.total * s_band_pixel_weight), s_band_pixel_weight};
+}
+
+PixelCounts<uint64_t> Sampler::level_counts(uint32_t level, uint32_t x, uint32_t y) const
+{
+	if (level == 0)
+		return grid_counts(x, y);
+	return m_levels[level - 1].cells[(size_t)y * (m_grid_size >> level) + x];
+}
+
+void Sampler::update_levels(uint32_t level_count)
+{
+	ProfileScope scope("Count levels");
+	if (m_levels.size() < level_count)
+		m_levels.resize(level_count);
+
+	// Each level is re-summed from the one below under the grid tiles changed since it was
+	// last current, which is every tile for a new level
+	for (uint32_t level = 1; level <= level_count; ++level)
+	{
+		CountLevel &counts = m_levels[level - 1];
+		uint32_t width = m_grid_size >> level;
+		if (counts.cells.empty())
+			counts.cells.assign((size_t)width * width, {});
+		for (uint32_t tile = 0; tile < m_tile_versions.size(); ++tile)
+		{
+			if (m_tile_versions[tile] <= counts.version)
+				continue;
+
+			uint32_t grid_x = (tile % m_tiles_per_row) * s_tile_size;
+			uint32_t grid_y = (tile / m_tiles_per_row) * s_tile_size;
+			uint32_t x_end = ((std::min(m_grid_size, grid_x + s_tile_size) - 1) >> level) + 1;
+			uint32_t y_end = ((std::min(m_grid_size, grid_y + s_tile_size) - 1) >> level) + 1;
+			for (uint32_t y = grid_y >> level; y < y_end; ++y)
+			{
+				for (uint32_t x = grid_x >> level; x < x_end; ++x)
+				{
+					PixelCounts<uint64_t> sum;
+					for (uint32_t child = 0; child < 4; ++child)
+					{
+						PixelCounts<uint64_t> child_counts = level_counts(level - 1, 2 * x + (child & 1), 2 * y + (child >> 1));
+						sum.inside += child_counts.inside;
+						sum.total += child_counts.total;
+					}
+					counts.cells[(size_t)y * width + x] = sum;
+				}
+			}
+		}
+		counts.version = m_version;
+	}
+}
+
+void Sampler::resolve(uint32_t *pixels, uint64_t since)
+{
+	const std::vector<uint64_t> &versions = tile_versions();
+	uint32_t tiles_per_row = this->tiles_per_row();
+	uint32_t ratio = m_size / std::max(m_display_size, 1u);
+	uint32_t level = ratio > 1 ? (uint32_t)std::countr_zero(ratio) : 0;
+	if (level > 0)
+		update_levels(level);
+	for (uint32_t tile = 0; tile < versions.size(); ++tile)
+	{
+		if (versions[tile] <= since)
+			continue;
+
+		uint32_t x_begin = (tile % tiles_per_row) * s_tile_size;
+		uint32_t y_begin = (tile / tiles_per_row) * s_tile_size;
+		uint32_t x_end = std::min(m_display_size, x_begin + s_tile_size);
+		uint32_t y_end = std::min(m_display_size, y_begin + s_tile_size);
+		if (!display_is_grid())
+		{
+			// One cell of the display size's level per pixel, mirrored for a folded grid
+			for (uint32_t y = y_begin; y < y_end; ++y)
+			{
+				uint32_t grid_y, grid_y_end;
+				grid_span(y * ratio, (y + 1) * ratio, grid_y, grid_y_end);
+				for (uint32_t x = x_begin; x < x_end; ++x)
+				{
+					uint32_t grid_x, grid_x_end;
+					grid_span(x * ratio, (x + 1) * ratio, grid_x, grid_x_end);
+					pixels[(size_t)y * m_display_size + x] = resolve_color(level_counts(level, grid_x >> level, grid_y >> level));
+				}
+			}
+			continue;
+		}
+
+		const PixelCounts<uint64_t> *tile_cells = m_accumulation.cells.data() + ((size_t)tile << GridLayout::s_tile_cell_shift);
+		for (uint32_t y = y_begin; y < y_end; ++y)
+		{
+			for (uint32_t x = x_begin; x < x_end; ++x)
+				pixels[(size_t)y * m_size + x] = resolve_color(tile_cells[(y - y_begin) * s_tile_size + (x - x_begin)]);
+		}
+	}
+}
+
+template <typename Count>
+Sampler::SampleCounts Sampler::accumulate(uint64_t first_sample, uint64_t count, AccumulationBuffers<Count> &buffers) const
+{
+	if (m_grid_size == 0)
+		return count_points(first_sample, count);
+
+	// The SIMD kernel classifies a block of points, the scatter into the grid stays scalar
+	uint32_t cell_indices[s_block_size];
+	uint32_t inside[s_block_size];
+	SampleCounts counts;
+	for (uint64_t offset = 0; offset < count; offset += s_block_size)
+	{
+		uint32_t block = (uint32_t)std::min<uint64_t>(s_block_size, count - offset);
+		counts.inside_pairs += classify(first_sample + offset, block, cell_indices, inside);
+
+		for (uint32_t i = 0; i < block; ++i)
+		{
+			uint32_t cell_index = cell_indices[i];
+			PixelCounts<Count> &cell = buffers.cells[cell_index];
+			cell.total++;
+			cell.inside += inside[i];
+			buffers.touched_tiles[GridLayout::tile_of(cell_index)] = 1;
+			counts.inside_circle += inside[i];
+		}
+	}
+	return counts;
+}
+
+StrategyRun Sampler::strategy_run() const
+{
+	StrategyRun run;
+	run.strategy = m_strategy;
+	run.mode = m_mode;
+	run.seed = m_seed;
+	run.size = m_grid_size;
+	run.strata = &m_strata;
+	return run;
+}
+
+// Maps cells of a plain grid `size` wide to the folded grid's, mirrored into the quadrant.
+// The tile row is found with a multiply by the reciprocal of the row width, exact while
+// tile * tiles_per_row < 2^40, which holds for any grid with 32-bit cell indices.
+class CellFolder
+{
+public:
+	CellFolder(uint32_t size, uint32_t folded_tiles_per_row)
+		: m_half(size / 2), m_tiles_per_row(GridLayout::tiles_per_row(size)), m_folded_tiles_per_row(folded_tiles_per_row),
+		  m_reciprocal((1ull << 40) / m_tiles_per_row + 1)
+	{
+	}
+
+	uint32_t operator()(uint32_t cell_index) const
+	{
+		uint32_t tile = GridLayout::tile_of(cell_index);
+		uint32_t tile_y = (uint32_t)((tile * m_reciprocal) >> 40);
+		uint32_t tile_x = tile - tile_y * m_tiles_per_row;
+		uint32_t x = (tile_x << GridLayout::s_tile_shift) | (cell_index & (GridLayout::s_tile_size - 1));
+		uint32_t y = (tile_y << GridLayout::s_tile_shift) | ((cell_index >> GridLayout::s_tile_shift) & (GridLayout::s_tile_size - 1));
+		x = x >= m_half ? x - m_half : m_half - 1 - x;
+		y = y >= m_half ? y - m_half : m_half - 1 - y;
+		return GridLayout::cell_index(x, y, m_folded_tiles_per_row);
+	}
+
+private:
+	uint32_t m_half;
+	uint32_t m_tiles_per_row;
+	uint32_t m_folded_tiles_per_row;
+	uint64_t m_reciprocal;
+};
+
+Sampler::SampleCounts Sampler::count_points(uint64_t first_sample, uint64_t count) const
+{
+	// Quadrant counts the plain samples, their inside test is the same folded or not
+	SampleCounts counts;
+	if (is_folded(m_strategy) && m_strategy != SamplingStrategy::Quadrant)
+		counts.inside_circle = count_inside_strategy(strategy_run(), first_sample, count, counts.inside_pairs);
+	else if (m_mode == SamplingMode::Random)
+		counts.inside_circle = count_inside(m_seed, first_sample, count);
+	else if (m_mode == SamplingMode::RandomExact)
+		counts.inside_circle = count_inside_exact(m_seed, first_sample, count);
+	else
+		counts.inside_circle = count_inside_sequence(m_mode, m_seed, first_sample, count);
+	return counts;
+}
+
+uint64_t Sampler::classify(uint64_t first_sample, uint32_t count, uint32_t *cell_indices, uint32_t *inside) const
+{
+	if (is_folded(m_strategy) && m_strategy != SamplingStrategy::Quadrant)
+		return classify_strategy(strategy_run(), first_sample, count, cell_indices, inside);
+	if (m_mode == SamplingMode::Random)
+		classify_points(m_seed, first_sample, count, m_size, cell_indices, inside);
+	else if (m_mode == SamplingMode::RandomExact)
+		classify_points_exact(m_seed, first_sample, count, m_size, cell_indices, inside);
+	else
+		classify_sequence(m_mode, m_seed, first_sample, count, m_size, cell_indices, inside);
+
+	// A sample lands in pixel floor(u * size), so the mirrored pixel is the folded one
+	if (m_strategy == SamplingStrategy::Quadrant)
+	{
+		CellFolder fold(m_size, m_tiles_per_row);
+		for (uint32_t i = 0; i < count; ++i)
+			cell_indices[i] = fold(cell_indices[i]);
+	}
+	return 0;
+}
+
+void Sampler::merge(uint32_t worker_count)
+{
+	// Each task owns a range of tiles and drains the workers' buffers for the tiles they touched
+	uint32_t tile_count = (uint32_t)m_tile_versions.size();
+	uint32_t tiles_per_task = (tile_count + worker_count - 1) / worker_count;
+	m_pool->run(worker_count, [&](uint32_t task) {
+		ProfileScope scope("Merge");
+		uint32_t tile_begin = std::min(tile_count, tiles_per_task * task);
+		uint32_t tile_end = std::min(tile_count, tile_begin + tiles_per_task);
+		for (uint32_t tile = tile_begin; tile < tile_end; ++tile)
+		{
+			size_t begin = (size_t)tile << GridLayout::s_tile_cell_shift;
+			size_t end = begin + GridLayout::s_tile_cells;
+			for (uint32_t worker = 0; worker < worker_count; ++worker)
+			{
+				AccumulationBuffers<uint32_t> &buffers = m_worker_accumulation[worker];
+				if (!buffers.touched_tiles[tile])
+					continue;
+				buffers.touched_tiles[tile] = 0;
+				m_tile_versions[tile] = m_version;
+
+				for (size_t i = begin; i < end; ++i)
+				{
+					m_accumulation.cells[i].inside += buffers.cells[i].inside;
+					m_accumulation.cells[i].total += buffers.cells[i].total;
+					buffers.cells[i] = {};
+				}
+			}
+		}
+	});
+}
+
+void Sampler::stamp_touched_tiles()
+{
+	for (size_t tile = 0; tile < m_tile_versions.size(); ++tile)
+	{
+		if (m_accumulation.touched_tiles[tile])
+		{
+			m_accumulation.touched_tiles[tile] = 0;
+			m_tile_versions[tile] = m_version;
+		}
+	}
+}
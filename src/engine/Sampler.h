@@ -0,0 +1,255 @@
+#pragma once
+
+#include "GridLayout.h"
+#include "Sequence.h"
+#include "Statistics.h"
+#include "Strategy.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WorkerPool;
+
+struct Color
+{
+	uint8_t r = 0;
+	uint8_t g = 0;
+	uint8_t b = 0;
+};
+
+inline uint32_t ToColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	// RGBA8888 format: R in bits 24-31, G in bits 16-23, B in bits 8-15, A in bits 0-7
+	return (r << 24) | (g << 16) | (b << 8) | (a << 0);
+}
+
+// Per-pixel sample counts, interleaved so a sample touches a single cache line.
+// Colors are derived from inside / total at resolve time.
+template <typename Count>
+struct PixelCounts
+{
+	Count inside = 0;
+	Count total = 0;
+};
+
+// Counts stored as in GridLayout, one cell per pixel plus the padding of the edge tiles
+template <typename Count>
+struct AccumulationBuffers
+{
+	std::vector<PixelCounts<Count>> cells;
+	// One flag per tile that received a sample since the buffers were last merged
+	std::vector<uint8_t> touched_tiles;
+
+	void assign(size_t tile_count)
+	{
+		cells.assign(tile_count * GridLayout::s_tile_cells, {});
+		touched_tiles.assign(tile_count, 0);
+	}
+};
+
+// One worker's block of classified samples, counting-sorted by bin (a run of tiles)
+struct SampleBins
+{
+	// Cell index within the bin, inside flag in the top bit
+	std::vector<uint32_t> entries;
+	// Bin b holds entries [offsets[b], offsets[b + 1])
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> cursors;
+	std::vector<uint32_t> cell_indices;
+	std::vector<uint32_t> inside;
+};
+
+// Everything needed to continue a run, see Sampler::save() and Checkpoint.h
+struct SamplerState
+{
+	uint32_t size = 0;
+	uint32_t seed = 0;
+	SamplingMode mode = SamplingMode::Pcg64;
+	SamplingStrategy strategy = SamplingStrategy::Plain;
+	uint64_t next_sample = 0;
+	uint64_t total_points = 0;
+	uint64_t inside_circle = 0;
+	uint64_t inside_pairs = 0;
+	std::vector<PixelCounts<uint64_t>> cells; // As in GridLayout, grid_width(strategy, size) wide
+};
+
+// Monte Carlo kernel: throws points at the [-1,1]^2 square, counts the ones inside the
+// unit circle and counts the inside/total samples per pixel of a size x size grid.
+// Has no dependency on SDL or ImGui so it can be driven by the viewer or headless.
+// A size of 0 skips the grid and only counts, which runs fully in the SIMD kernel.
+//
+// Sample i always uses draws 2i and 2i+1 of the sequence started from the seed, or point i
+// of the sampling mode's generator or sequence (see Sequence.h). Workers skip ahead to
+// disjoint slices of that sequence, so the result depends only on the seed and the mode.
+// A single worker scatters straight into the shared grid. Several workers accumulate into
+// private buffers merged once per sample() call while the grid is small; larger grids
+// would need a full copy per worker, so their samples are generated a block at a time,
+// binned by runs of tiles that fit in L2, and each bin is accumulated by the one worker
+// that owns its tiles.
+//
+// The shared grid keeps 64-bit counts so long runs never overflow. Worker buffers are
+// drained every batch and no worker takes 2^32 samples per batch, so they use 32-bit
+// counts at half the footprint.
+//
+// The grid is split into s_tile_size square tiles. Every change bumps version() and
+// stamps the tiles it touched, so consumers can re-resolve only what changed since the
+// version they last saw.
+//
+// The image can be resolved at a smaller power-of-two display size than the grid. A sample
+// lands in pixel floor(u * size) for every mode, so each display pixel is exactly the sum
+// of the grid pixels under it: the same counts a run at the display size would have. Those
+// sums are kept as count levels, each half the width of the one below, built the first
+// time a display size needs them and then only re-summed under the grid tiles that changed.
+//
+// A sampling strategy other than Plain (see Strategy.h) only samples the quadrant [0,1]^2,
+// into a grid of size / 2 that resolve() mirrors into the four quadrants of the image.
+class Sampler
+{
+public:
+	static constexpr uint32_t s_tile_size = GridLayout::s_tile_size;
+
+	explicit Sampler(uint32_t size, uint32_t thread_count = 1, uint32_t seed = 0);
+	~Sampler();
+
+	void sample(uint64_t count);
+	void reset(uint32_t size);
+	void set_colors(Color inside, Color outside);
+	void set_thread_count(uint32_t thread_count);
+	// Changes what every sample index means, so it also starts a new run
+	void set_sampling_mode(SamplingMode mode);
+	// Also starts a new run; returns false, and changes nothing, if the strategy does not
+	// support the grid size. reset() to an unsupported size falls back to Plain.
+	bool set_sampling_strategy(SamplingStrategy strategy);
+
+	// Copies the run into `state`, reusing its memory. restore() takes over the state's
+	// cells and continues the run exactly where it was saved; it returns false, and leaves
+	// the run alone, if the state does not describe a valid grid.
+	void save(SamplerState &state) const;
+	bool restore(SamplerState &&state);
+
+	// Marks every tile as changed, e.g. after set_colors() so they resolve to the new colors
+	void touch_all_tiles();
+
+	// Resolves the grid at `size`, which must be the grid size or a smaller power of two
+	// than a power-of-two grid, and at least 2 for a folded strategy; returns false and
+	// keeps the display size otherwise. The run goes on unchanged. A new grid size keeps
+	// the display size if it still fits.
+	static bool can_display(uint32_t grid_size, uint32_t size, SamplingStrategy strategy = SamplingStrategy::Plain);
+	bool set_display_size(uint32_t size);
+
+	// Writes display_size * display_size RGBA8888 pixels, black where no sample has landed
+	// yet. Only tiles changed after version `since` are written, so `pixels` must hold the
+	// image at this display size as of that version. Brings the count levels up to date.
+	void resolve(uint32_t *pixels, uint64_t since = 0);
+
+	uint32_t size() const { return m_size; }
+	uint32_t display_size() const { return m_display_size; }
+	uint32_t seed() const { return m_seed; }
+	SamplingMode sampling_mode() const { return m_mode; }
+	SamplingStrategy sampling_strategy() const { return m_strategy; }
+	uint32_t thread_count() const;
+	uint64_t total_points() const { return m_total_points; }
+	uint64_t inside_circle() const { return m_inside_circle; }
+	// Antithetic pairs with both points inside
+	uint64_t inside_pairs() const { return m_inside_pairs; }
+	uint64_t next_sample() const { return m_next_sample; }
+	// Counts as in GridLayout, grid_size() wide
+	const std::vector<PixelCounts<uint64_t>> &cells() const { return m_accumulation.cells; }
+	uint32_t grid_size() const { return m_grid_size; }
+
+	// Estimate of pi and its interval at `z` standard errors, for the run's strategy
+	EstimateStatistics statistics(double z) const;
+	// Samples the whole run needs for a half-width of `epsilon`, as samples_for_precision()
+	// in Statistics.h but with the strategy's own variance
+	uint64_t samples_for_precision(double epsilon, double z) const;
+	// Memory held by the grid and the workers' buffers and bins
+	uint64_t accumulation_bytes() const;
+
+	// Tiles of the resolved image, at the display size
+	uint64_t version() const { return m_version; }
+	uint32_t tiles_per_row() const { return GridLayout::tiles_per_row(m_display_size); }
+	const std::vector<uint64_t> &tile_versions() const { return display_is_grid() ? m_tile_versions : m_display_tile_versions; }
+
+private:
+	struct SampleCounts
+	{
+		uint64_t inside_circle = 0;
+		uint64_t inside_pairs = 0;
+	};
+
+	template <typename Count>
+	SampleCounts accumulate(uint64_t first_sample, uint64_t count, AccumulationBuffers<Count> &buffers) const;
+	void sample_batch(uint64_t count);
+	void sample_private(uint64_t count, uint32_t worker_count);
+	void sample_binned(uint64_t count, uint32_t worker_count);
+	SampleCounts bin_samples(uint64_t first_sample, uint32_t count, SampleBins &bins) const;
+	void accumulate_bins(uint32_t bin_begin, uint32_t bin_end, uint32_t worker_count);
+	void merge(uint32_t worker_count);
+	void stamp_touched_tiles();
+	void stamp_display_tiles();
+	void grid_span(uint32_t begin, uint32_t end, uint32_t &grid_begin, uint32_t &grid_end) const;
+	void update_levels(uint32_t level_count);
+	PixelCounts<uint64_t> grid_counts(uint32_t x, uint32_t y) const;
+	PixelCounts<uint64_t> level_counts(uint32_t level, uint32_t x, uint32_t y) const;
+	uint32_t resolve_color(const PixelCounts<uint64_t> &counts) const;
+	void set_grid(uint32_t size, std::vector<PixelCounts<uint64_t>> cells);
+	SampleCounts count_points(uint64_t first_sample, uint64_t count) const;
+	uint64_t classify(uint64_t first_sample, uint32_t count, uint32_t *cell_indices, uint32_t *inside) const;
+	StrategyRun strategy_run() const;
+	EstimateStatistics stratified_statistics(double z) const;
+
+	bool display_is_grid() const { return m_display_size == m_size && !is_folded(m_strategy); }
+	bool use_bins() const { return m_accumulation.cells.size() * sizeof(PixelCounts<uint64_t>) > s_max_private_grid_bytes; }
+	uint32_t bin_count() const { return (uint32_t)((m_accumulation.cells.size() + s_bin_cells - 1) / s_bin_cells); }
+
+private:
+	// Below this many samples per worker the merge costs more than the extra threads save
+	static constexpr uint64_t s_min_samples_per_worker = 1 << 16;
+	static constexpr uint32_t s_block_size = 4096;
+	// Keeps every worker's 32-bit counts from overflowing between merges
+	static constexpr uint64_t s_max_samples_per_worker = 1ull << 31;
+	// Grids larger than this are binned instead of copied per worker
+	static constexpr size_t s_max_private_grid_bytes = 4 << 20;
+	// A bin covers 16 tiles, 1 MB of shared counts, so its scatter stays in L2
+	static constexpr uint32_t s_bin_cell_shift = GridLayout::s_tile_cell_shift + 4;
+	static constexpr uint32_t s_bin_cells = 1u << s_bin_cell_shift;
+	static constexpr uint32_t s_bin_block_size = 1 << 16;
+	// Weight of a known pixel of the band in the count levels, split by its inside fraction
+	static constexpr uint64_t s_band_pixel_weight = 1 << 24;
+
+	uint32_t m_size = 0;
+	uint32_t m_grid_size = 0;
+	uint32_t m_tiles_per_row = 0;
+	uint32_t m_seed = 0;
+	SamplingMode m_mode = SamplingMode::Pcg64;
+	SamplingStrategy m_strategy = SamplingStrategy::Plain;
+	StrataLayout m_strata;
+	uint64_t m_next_sample = 0;
+
+	Color m_inside_color = {120, 160, 255};
+	Color m_outside_color = {255, 140, 140};
+
+	AccumulationBuffers<uint64_t> m_accumulation;
+	std::vector<AccumulationBuffers<uint32_t>> m_worker_accumulation;
+	std::vector<SampleBins> m_worker_bins;
+	std::unique_ptr<WorkerPool> m_pool;
+
+	uint64_t m_version = 0;
+	std::vector<uint64_t> m_tile_versions;
+	uint32_t m_display_size = 0;
+	// Newest version of the grid tiles under each display tile, when the sizes differ
+	std::vector<uint64_t> m_display_tile_versions;
+
+	struct CountLevel
+	{
+		std::vector<PixelCounts<uint64_t>> cells; // Row-major
+		uint64_t version = 0; // Of the grid when the level was last summed
+	};
+	// Level l sums the 2^l x 2^l blocks of the grid, m_levels[l - 1]; the grid is level 0
+	std::vector<CountLevel> m_levels;
+
+	uint64_t m_total_points = 0;
+	uint64_t m_inside_circle = 0;
+	uint64_t m_inside_pairs = 0;
+};
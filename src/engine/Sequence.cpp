@@ -0,0 +1,448 @@
+#include "Sequence.h"
+#include "GridLayout.h"
+#include "Random.h"
+#include "RandomPolicies.h"
+
+#include <array>
+#include <bit>
+#include <optional>
+#include <string.h>
+
+// Points are 64-bit fixed-point fractions of the unit square, so sequences that are exact
+// in binary (Sobol, R2, base 2) stay exact for any index
+
+static uint32_t ReverseBits32(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	return std::byteswap(x);
+}
+
+static uint64_t ReverseBits64(uint64_t x)
+{
+	return ((uint64_t)ReverseBits32((uint32_t)x) << 32) | ReverseBits32((uint32_t)(x >> 32));
+}
+
+// Independent 32-bit values derived from the seed, one per use
+static uint32_t SeedWord(uint32_t seed, uint32_t word)
+{
+	return random_hash(random_advance(seed, word + 1));
+}
+
+// Laine-Karras hash on the reversed bits: every bit is flipped depending only on the bits
+// above it, which is a nested uniform (Owen) scramble of a 32-bit fraction
+static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+{
+	x = ReverseBits32(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return ReverseBits32(x);
+}
+
+// The low half's permutation depends on all of the high half, as Owen scrambling requires
+static uint64_t OwenScramble(uint64_t x, uint32_t seed)
+{
+	uint32_t high = (uint32_t)(x >> 32);
+	uint32_t low_seed = random_hash(seed ^ random_hash(high));
+	return ((uint64_t)NestedUniformScramble(high, seed) << 32) | NestedUniformScramble((uint32_t)x, low_seed);
+}
+
+// Sobol in Gray-code order: consecutive indices differ by one direction number per
+// dimension, and every aligned block of 2^k points is still a (0, k, 2)-net
+template <bool Scrambled>
+class SobolGenerator
+{
+public:
+	SobolGenerator(uint32_t seed, uint64_t index)
+		: m_index(index)
+	{
+		uint64_t gray = index ^ (index >> 1);
+		for (uint32_t bit = 0; bit < 64; ++bit)
+		{
+			if (gray & (1ull << bit))
+			{
+				m_x ^= s_directions.x[bit];
+				m_y ^= s_directions.y[bit];
+			}
+		}
+		m_x_seed = SeedWord(seed, 0);
+		m_y_seed = SeedWord(seed, 1);
+	}
+
+	void next(uint64_t &x, uint64_t &y)
+	{
+		if constexpr (Scrambled)
+		{
+			x = OwenScramble(m_x, m_x_seed);
+			y = OwenScramble(m_y, m_y_seed);
+		}
+		else
+		{
+			x = m_x;
+			y = m_y;
+		}
+
+		uint32_t bit = std::countr_zero(++m_index) & 63;
+		m_x ^= s_directions.x[bit];
+		m_y ^= s_directions.y[bit];
+	}
+
+private:
+	struct Directions
+	{
+		std::array<uint64_t, 64> x;
+		std::array<uint64_t, 64> y;
+	};
+
+	// The first dimension is van der Corput; the second uses the primitive polynomial x + 1
+	static constexpr Directions MakeDirections()
+	{
+		Directions directions = {};
+		for (uint32_t bit = 0; bit < 64; ++bit)
+		{
+			directions.x[bit] = 1ull << (63 - bit);
+			directions.y[bit] = bit == 0 ? 1ull << 63 : directions.y[bit - 1] ^ (directions.y[bit - 1] >> 1);
+		}
+		return directions;
+	}
+
+	static constexpr Directions s_directions = MakeDirections();
+
+	uint64_t m_index;
+	uint64_t m_x = 0;
+	uint64_t m_y = 0;
+	uint32_t m_x_seed;
+	uint32_t m_y_seed;
+};
+
+// Halton in bases 2 and 3. The base 3 radical inverse is read from a table of 7-digit
+// blocks; only the lowest block changes from one index to the next.
+template <bool Shifted>
+class HaltonGenerator
+{
+public:
+	HaltonGenerator(uint32_t seed, uint64_t index)
+		: m_index(index), m_low((uint32_t)(index % s_block)), m_high(index / s_block)
+	{
+		m_high_inverse = RadicalInverse3(m_high) / s_block;
+		if constexpr (Shifted)
+		{
+			m_x_shift = ((uint64_t)SeedWord(seed, 0) << 32) | SeedWord(seed, 1);
+			m_y_shift = ((uint64_t)SeedWord(seed, 2) << 32) | SeedWord(seed, 3);
+		}
+	}
+
+	void next(uint64_t &x, uint64_t &y)
+	{
+		// The sum only rounds up to 1 for indices near 3^40, and then wraps to 0
+		double inverse = s_table.values[m_low] + m_high_inverse;
+		x = ReverseBits64(m_index) + m_x_shift;
+		y = ((uint64_t)(inverse * 0x1p53) << 11) + m_y_shift;
+
+		m_index++;
+		if (++m_low == s_block)
+		{
+			m_low = 0;
+			m_high++;
+			m_high_inverse = RadicalInverse3(m_high) / s_block;
+		}
+	}
+
+private:
+	static constexpr uint32_t s_digits = 7;
+	static constexpr uint32_t s_block = 2187; // 3^s_digits
+
+	struct Table
+	{
+		std::array<double, s_block> values;
+	};
+
+	static constexpr Table MakeTable()
+	{
+		Table table = {};
+		for (uint32_t i = 0; i < s_block; ++i)
+		{
+			double value = 0.0;
+			double scale = 1.0 / 3.0;
+			for (uint32_t n = i; n > 0; n /= 3, scale /= 3.0)
+				value += (n % 3) * scale;
+			table.values[i] = value;
+		}
+		return table;
+	}
+
+	static double RadicalInverse3(uint64_t index)
+	{
+		double value = 0.0;
+		double scale = 1.0;
+		for (; index > 0; index /= s_block, scale /= s_block)
+			value += s_table.values[index % s_block] * scale;
+		return value;
+	}
+
+	static constexpr Table s_table = MakeTable();
+
+	uint64_t m_index;
+	uint32_t m_low;
+	uint64_t m_high;
+	double m_high_inverse;
+	uint64_t m_x_shift = 0;
+	uint64_t m_y_shift = 0;
+};
+
+// Roberts' R2: additive recurrence on the inverse powers of the plastic number, computed
+// modulo 2^64 so point i is exact however large i gets
+template <bool Shifted>
+class R2Generator
+{
+public:
+	R2Generator(uint32_t seed, uint64_t index)
+	{
+		uint64_t x_offset = 1ull << 63;
+		uint64_t y_offset = 1ull << 63;
+		if constexpr (Shifted)
+		{
+			x_offset = ((uint64_t)SeedWord(seed, 0) << 32) | SeedWord(seed, 1);
+			y_offset = ((uint64_t)SeedWord(seed, 2) << 32) | SeedWord(seed, 3);
+		}
+		m_x = x_offset + index * s_x_step;
+		m_y = y_offset + index * s_y_step;
+	}
+
+	void next(uint64_t &x, uint64_t &y)
+	{
+		x = m_x;
+		y = m_y;
+		m_x += s_x_step;
+		m_y += s_y_step;
+	}
+
+private:
+	static constexpr uint64_t s_x_step = 0xc13fa9a902a6328full; // 2^64 / plastic number
+	static constexpr uint64_t s_y_step = 0x91e10da5c79e7b1cull; // 2^64 / plastic number^2
+
+	uint64_t m_x;
+	uint64_t m_y;
+};
+
+// Points from one of the 64-bit generators of RandomPolicies.h: sample i is draws 2i and
+// 2i + 1, reached by skipping ahead
+template <typename Random>
+class PseudoRandomGenerator
+{
+public:
+	PseudoRandomGenerator(uint32_t seed, uint64_t index)
+		: m_random(seed)
+	{
+		m_random.discard(2 * index);
+	}
+
+	void next(uint64_t &x, uint64_t &y)
+	{
+		x = m_random.next();
+		y = m_random.next();
+	}
+
+private:
+	Random m_random;
+};
+
+// Each thread usually gets the blocks of a run in order, so it keeps the generator where
+// the previous block left it rather than seeking again, which costs thousands of steps
+// for xoshiro
+template <typename Generator>
+struct GeneratorCache
+{
+	uint32_t seed = 0;
+	uint64_t next_sample = 0;
+	std::optional<Generator> generator;
+
+	Generator &seek(uint32_t run_seed, uint64_t first_sample, uint64_t count)
+	{
+		if (!generator || seed != run_seed || next_sample != first_sample)
+			generator.emplace(run_seed, first_sample);
+		seed = run_seed;
+		next_sample = first_sample + count;
+		return *generator;
+	}
+};
+
+// Tested at the middle of the point's 2^-53 cell, in double: the squares round at about
+// 1e-16, far below the error of any run
+static inline bool IsInside(uint64_t x, uint64_t y)
+{
+	double x_coord = ((double)(x >> 11) + 0.5) * 0x1p-52 - 1.0;
+	double y_coord = ((double)(y >> 11) + 0.5) * 0x1p-52 - 1.0;
+	return x_coord * x_coord + y_coord * y_coord <= 1.0;
+}
+
+static inline uint32_t PixelOf(uint64_t coord, uint32_t size)
+{
+	return (uint32_t)(((coord >> 32) * size) >> 32);
+}
+
+template <typename Generator>
+static uint64_t CountInside(uint32_t seed, uint64_t first_sample, uint64_t count)
+{
+	thread_local GeneratorCache<Generator> cache;
+	Generator &generator = cache.seek(seed, first_sample, count);
+	uint64_t inside = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t x, y;
+		generator.next(x, y);
+		inside += IsInside(x, y);
+	}
+	return inside;
+}
+
+template <typename Generator>
+static void Classify(uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	thread_local GeneratorCache<Generator> cache;
+	Generator &generator = cache.seek(seed, first_sample, count);
+	uint32_t tiles_per_row = GridLayout::tiles_per_row(size);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint64_t x, y;
+		generator.next(x, y);
+		cell_indices[i] = GridLayout::cell_index(PixelOf(x, size), PixelOf(y, size), tiles_per_row);
+		inside[i] = IsInside(x, y);
+	}
+}
+
+template <typename Generator>
+static void Points(uint32_t seed, uint64_t first_sample, uint32_t count, uint64_t *x, uint64_t *y)
+{
+	thread_local GeneratorCache<Generator> cache;
+	Generator &generator = cache.seek(seed, first_sample, count);
+	for (uint32_t i = 0; i < count; ++i)
+		generator.next(x[i], y[i]);
+}
+
+static const char *const s_mode_names[] = {"random", "sobol", "sobol-owen", "halton", "halton-shifted", "r2", "r2-shifted", "pcg64", "xoshiro256+", "philox", "random-exact"};
+static_assert(sizeof(s_mode_names) / sizeof(s_mode_names[0]) == (size_t)SamplingMode::Count);
+
+const char *sampling_mode_name(SamplingMode mode)
+{
+	return mode < SamplingMode::Count ? s_mode_names[(uint32_t)mode] : "unknown";
+}
+
+bool parse_sampling_mode(const char *name, SamplingMode &mode)
+{
+	for (uint32_t i = 0; i < (uint32_t)SamplingMode::Count; ++i)
+	{
+		if (strcmp(name, s_mode_names[i]) == 0)
+		{
+			mode = (SamplingMode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool is_low_discrepancy(SamplingMode mode)
+{
+	return mode >= SamplingMode::Sobol && mode <= SamplingMode::R2Shifted;
+}
+
+uint64_t sample_period(SamplingMode mode)
+{
+	return mode == SamplingMode::Random || mode == SamplingMode::RandomExact ? (uint64_t)1 << 31 : UINT64_MAX;
+}
+
+uint64_t count_inside_sequence(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint64_t count)
+{
+	switch (mode)
+	{
+	case SamplingMode::Sobol:
+		return CountInside<SobolGenerator<false>>(seed, first_sample, count);
+	case SamplingMode::SobolOwen:
+		return CountInside<SobolGenerator<true>>(seed, first_sample, count);
+	case SamplingMode::Halton:
+		return CountInside<HaltonGenerator<false>>(seed, first_sample, count);
+	case SamplingMode::HaltonShifted:
+		return CountInside<HaltonGenerator<true>>(seed, first_sample, count);
+	case SamplingMode::R2:
+		return CountInside<R2Generator<false>>(seed, first_sample, count);
+	case SamplingMode::R2Shifted:
+		return CountInside<R2Generator<true>>(seed, first_sample, count);
+	case SamplingMode::Pcg64:
+		return CountInside<PseudoRandomGenerator<Pcg64>>(seed, first_sample, count);
+	case SamplingMode::Xoshiro256Plus:
+		return CountInside<PseudoRandomGenerator<Xoshiro256Plus>>(seed, first_sample, count);
+	case SamplingMode::Philox:
+		return CountInside<PseudoRandomGenerator<Philox4x32>>(seed, first_sample, count);
+	default:
+		return 0;
+	}
+}
+
+void classify_sequence(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	switch (mode)
+	{
+	case SamplingMode::Sobol:
+		return Classify<SobolGenerator<false>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::SobolOwen:
+		return Classify<SobolGenerator<true>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::Halton:
+		return Classify<HaltonGenerator<false>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::HaltonShifted:
+		return Classify<HaltonGenerator<true>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::R2:
+		return Classify<R2Generator<false>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::R2Shifted:
+		return Classify<R2Generator<true>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::Pcg64:
+		return Classify<PseudoRandomGenerator<Pcg64>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::Xoshiro256Plus:
+		return Classify<PseudoRandomGenerator<Xoshiro256Plus>>(seed, first_sample, count, size, cell_indices, inside);
+	case SamplingMode::Philox:
+		return Classify<PseudoRandomGenerator<Philox4x32>>(seed, first_sample, count, size, cell_indices, inside);
+	default:
+		break;
+	}
+}
+
+void sequence_points(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint32_t count, uint64_t *x, uint64_t *y)
+{
+	switch (mode)
+	{
+	case SamplingMode::Random:
+	case SamplingMode::RandomExact:
+	{
+		uint32_t rng_state = random_advance(seed, first_sample * 2);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			x[i] = ((uint64_t)random_bits(rng_state) << 32) | 0x80000000u;
+			y[i] = ((uint64_t)random_bits(rng_state) << 32) | 0x80000000u;
+		}
+		return;
+	}
+	case SamplingMode::Sobol:
+		return Points<SobolGenerator<false>>(seed, first_sample, count, x, y);
+	case SamplingMode::SobolOwen:
+		return Points<SobolGenerator<true>>(seed, first_sample, count, x, y);
+	case SamplingMode::Halton:
+		return Points<HaltonGenerator<false>>(seed, first_sample, count, x, y);
+	case SamplingMode::HaltonShifted:
+		return Points<HaltonGenerator<true>>(seed, first_sample, count, x, y);
+	case SamplingMode::R2:
+		return Points<R2Generator<false>>(seed, first_sample, count, x, y);
+	case SamplingMode::R2Shifted:
+		return Points<R2Generator<true>>(seed, first_sample, count, x, y);
+	case SamplingMode::Pcg64:
+		return Points<PseudoRandomGenerator<Pcg64>>(seed, first_sample, count, x, y);
+	case SamplingMode::Xoshiro256Plus:
+		return Points<PseudoRandomGenerator<Xoshiro256Plus>>(seed, first_sample, count, x, y);
+	case SamplingMode::Philox:
+		return Points<PseudoRandomGenerator<Philox4x32>>(seed, first_sample, count, x, y);
+	default:
+		break;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+// Where sample i of a run comes from. Pcg64, Xoshiro256Plus and Philox are the 64-bit
+// generators of RandomPolicies.h; Pcg64 is the default, since it never repeats within a
+// run and every seed selects its own stream. Random is the PCG-style hash stream of
+// Random.h, mapped through float like the original sampler, and RandomExact takes the same
+// draws in fixed point with an exact inside test (see SimdKernel.h). Both run in the SIMD
+// kernels several times faster, but the stream repeats after 2^31 samples and every seed is
+// an offset on the same cycle, so they are opt-in fast modes. The others are low-discrepancy
+// sequences whose error shrinks close to O(1/N) (about N^-3/4 for the circle's sharp
+// edge). Every mode computes point i from its index alone, by skipping ahead where it has
+// to, so workers still split a run anywhere and results depend only on the seed.
+//
+// A plain sequence ignores the seed and always gives the same points. The scrambled
+// variants randomize it from the seed while keeping its uniformity, so runs with
+// different seeds are independent estimates whose spread measures the error.
+enum class SamplingMode : uint32_t
+{
+	Random,
+	Sobol,
+	SobolOwen,		// Owen (nested uniform) scrambled Sobol
+	Halton,
+	HaltonShifted,	// Cranley-Patterson rotation
+	R2,
+	R2Shifted,
+	Pcg64,
+	Xoshiro256Plus,
+	Philox,			// Philox4x32-10
+	RandomExact,
+	Count,
+};
+
+const char *sampling_mode_name(SamplingMode mode);
+bool parse_sampling_mode(const char *name, SamplingMode &mode);
+bool is_low_discrepancy(SamplingMode mode);
+
+// Samples before the mode's points repeat. Random and RandomExact take two draws of the
+// 32-bit hash stream per sample, so sample i + 2^31 is sample i; the others do not repeat
+// within 64-bit sample indices and give UINT64_MAX.
+uint64_t sample_period(SamplingMode mode);
+
+// Same contract as count_inside() and classify_points() in SimdKernel.h, for the modes
+// other than Random and RandomExact. Points have 64-bit coordinates and are tested in double, since float
+// rounding would bias the estimate by more than the low-discrepancy sequences' error.
+uint64_t count_inside_sequence(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint64_t count);
+void classify_sequence(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside);
+
+// Points [first_sample, first_sample + count) of any mode as 64-bit fractions of the unit
+// square, for the sampling strategies (see Strategy.h). Random and RandomExact give their
+// 32-bit draws in the high half and the middle of the draw's cell in the low half.
+void sequence_points(SamplingMode mode, uint32_t seed, uint64_t first_sample, uint32_t count, uint64_t *x, uint64_t *y);
@@ -0,0 +1,283 @@
+#include "SharedRegion.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable_v<SharedRegionHeader>);
+static_assert(std::is_trivially_copyable_v<SharedSlot>);
+// Atomics in memory shared between processes must not hide a lock in the process
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free && std::atomic_ref<uint32_t>::is_always_lock_free);
+
+#if defined(_WIN32)
+
+static uint64_t CurrentProcessId()
+{
+	return GetCurrentProcessId();
+}
+
+static bool ProcessAlive(uint64_t process_id)
+{
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)process_id);
+	if (!process)
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	CloseHandle(process);
+	return alive;
+}
+
+#else
+
+static uint64_t CurrentProcessId()
+{
+	return (uint64_t)getpid();
+}
+
+static bool ProcessAlive(uint64_t process_id)
+{
+	return kill((pid_t)process_id, 0) == 0 || errno == EPERM;
+}
+
+#endif
+
+static uint64_t CellCount(uint32_t size)
+{
+	uint64_t tiles_per_row = GridLayout::tiles_per_row(size);
+	return tiles_per_row * tiles_per_row * GridLayout::s_tile_cells;
+}
+
+uint64_t SharedRegion::slot_samples(SamplingMode mode, uint32_t slot_count)
+{
+	return std::min<uint64_t>(1ull << s_slot_sample_shift, sample_period(mode) / std::max(slot_count, 1u));
+}
+
+bool SharedRegion::open(const char *path, uint32_t size, uint32_t seed, SamplingMode mode, uint32_t slot_count)
+{
+	m_file.close();
+	m_slot = -1;
+
+	uint64_t cell_count = CellCount(size);
+	uint64_t cells_bytes = cell_count * sizeof(PixelCounts<uint64_t>);
+	uint64_t slot_stride = s_page_size + (2 * cells_bytes + s_page_size - 1) / s_page_size * s_page_size;
+	if (slot_count > 0 && m_file.create(path, s_page_size + slot_stride * slot_count, true))
+	{
+		SharedRegionHeader *region = header();
+		memcpy(region->magic, SharedRegionHeader::s_magic, sizeof(region->magic));
+		region->version = SharedRegionHeader::s_version;
+		region->byte_order = SharedRegionHeader::s_byte_order;
+		region->header_size = sizeof(SharedRegionHeader);
+		region->size = size;
+		region->seed = seed;
+		region->sampling_mode = (uint32_t)mode;
+		region->tile_size = GridLayout::s_tile_size;
+		region->slot_count = slot_count;
+		region->cell_count = cell_count;
+		region->slot_offset = s_page_size;
+		region->slot_stride = slot_stride;
+		for (uint32_t slot = 0; slot < slot_count; ++slot)
+			slot_at(slot)->first_sample = slot * slot_samples(mode, slot_count);
+
+		std::atomic_ref<uint32_t>(region->ready).store(1, std::memory_order_release);
+		return true;
+	}
+
+	// Someone else created it, maybe a moment ago
+	m_file.close();
+	if (!wait_ready(path))
+		return false;
+	const SharedRegionHeader *region = header();
+	return region->size == size && region->seed == seed && region->sampling_mode == (uint32_t)mode;
+}
+
+bool SharedRegion::attach(const char *path)
+{
+	m_file.close();
+	m_slot = -1;
+	return wait_ready(path);
+}
+
+bool SharedRegion::wait_ready(const char *path)
+{
+	// The creator sets `ready` right after sizing and filling the file
+	for (int attempt = 0; attempt < 500; ++attempt)
+	{
+		if (m_file.open_write(path) && m_file.size() >= sizeof(SharedRegionHeader) &&
+			std::atomic_ref<uint32_t>(header()->ready).load(std::memory_order_acquire))
+			break;
+		m_file.close();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (!m_file.data())
+		return false;
+
+	const SharedRegionHeader *region = header();
+	uint64_t cells_bytes = region->cell_count * sizeof(PixelCounts<uint64_t>);
+	if (memcmp(region->magic, SharedRegionHeader::s_magic, sizeof(region->magic)) != 0 ||
+		region->version != SharedRegionHeader::s_version ||
+		region->byte_order != SharedRegionHeader::s_byte_order ||
+		region->header_size != sizeof(SharedRegionHeader) ||
+		region->tile_size != GridLayout::s_tile_size ||
+		region->sampling_mode >= (uint32_t)SamplingMode::Count ||
+		region->cell_count != CellCount(region->size) ||
+		region->slot_stride < s_page_size + 2 * cells_bytes ||
+		m_file.size() < region->slot_offset + region->slot_stride * region->slot_count)
+	{
+		m_file.close();
+		return false;
+	}
+	return true;
+}
+
+PixelCounts<uint64_t> *SharedRegion::slot_cells(uint32_t slot, uint32_t buffer) const
+{
+	return (PixelCounts<uint64_t> *)((uint8_t *)slot_at(slot) + s_page_size) + header()->cell_count * buffer;
+}
+
+bool SharedRegion::claim_slot(SamplerState &state)
+{
+	uint64_t process_id = CurrentProcessId();
+	for (uint32_t slot = 0; slot < slot_count(); ++slot)
+	{
+		std::atomic_ref<uint64_t> owner(slot_at(slot)->owner);
+		uint64_t expected = owner.load(std::memory_order_acquire);
+		bool claimable = expected == 0 || (expected != process_id && !ProcessAlive(expected));
+		if (!claimable || !owner.compare_exchange_strong(expected, process_id, std::memory_order_acq_rel))
+			continue;
+
+		state.cells.assign(header()->cell_count, {});
+		SharedSlot::Counts counts = {slot_at(slot)->first_sample, 0, 0, 0};
+		read_slot(slot, counts, state.cells.data());
+		// A slot that sampled its whole range has nothing left to continue
+		if (counts.next_sample >= slot_at(slot)->first_sample + slot_samples())
+		{
+			owner.store(0, std::memory_order_release);
+			continue;
+		}
+
+		m_slot = (int32_t)slot;
+		state.size = size();
+		state.seed = seed();
+		state.mode = sampling_mode();
+		state.next_sample = counts.next_sample;
+		state.total_points = counts.total_points;
+		state.inside_circle = counts.inside_circle;
+		return true;
+	}
+	return false;
+}
+
+void SharedRegion::publish(const Sampler &sampler)
+{
+	ProfileScope scope("Publish shared");
+
+	SharedSlot *slot = slot_at((uint32_t)m_slot);
+	std::atomic_ref<uint64_t> sequence(slot->sequence);
+	uint64_t published = sequence.load(std::memory_order_relaxed);
+
+	// The buffer written now is the one readers used before the previous publish; keep
+	// that publish's sequence store ahead of these writes
+	std::atomic_thread_fence(std::memory_order_release);
+	uint32_t buffer = (uint32_t)(published & 1);
+	slot->counts[buffer] = {sampler.next_sample(), sampler.total_points(), sampler.inside_circle(), 0};
+	memcpy(slot_cells((uint32_t)m_slot, buffer), sampler.cells().data(), header()->cell_count * sizeof(PixelCounts<uint64_t>));
+	sequence.store(published + 1, std::memory_order_release);
+}
+
+void SharedRegion::release()
+{
+	if (m_slot < 0)
+		return;
+	std::atomic_ref<uint64_t>(slot_at((uint32_t)m_slot)->owner).store(0, std::memory_order_release);
+	m_slot = -1;
+}
+
+bool SharedRegion::read_slot(uint32_t slot, SharedSlot::Counts &counts, PixelCounts<uint64_t> *cells) const
+{
+	// Retries while the worker publishes over the buffer being copied
+	SharedSlot *shared = slot_at(slot);
+	std::atomic_ref<uint64_t> sequence(shared->sequence);
+	while (true)
+	{
+		uint64_t published = sequence.load(std::memory_order_acquire);
+		if (published == 0)
+			return false;
+
+		uint32_t buffer = (uint32_t)((published - 1) & 1);
+		SharedSlot::Counts copy = shared->counts[buffer];
+		if (cells)
+			memcpy(cells, slot_cells(slot, buffer), header()->cell_count * sizeof(PixelCounts<uint64_t>));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == published)
+		{
+			counts = copy;
+			return true;
+		}
+	}
+}
+
+uint32_t SharedRegion::aggregate(SamplerState &state)
+{
+	ProfileScope scope("Aggregate");
+
+	state.size = size();
+	state.seed = seed();
+	state.mode = sampling_mode();
+	state.next_sample = 0;
+	state.total_points = 0;
+	state.inside_circle = 0;
+	state.cells.assign(header()->cell_count, {});
+	m_scratch.resize(header()->cell_count);
+
+	uint32_t live_workers = 0;
+	for (uint32_t slot = 0; slot < slot_count(); ++slot)
+	{
+		uint64_t owner = std::atomic_ref<uint64_t>(slot_at(slot)->owner).load(std::memory_order_relaxed);
+		live_workers += owner != 0 && ProcessAlive(owner);
+
+		SharedSlot::Counts counts;
+		if (!read_slot(slot, counts, m_scratch.data()))
+			continue;
+		state.total_points += counts.total_points;
+		state.inside_circle += counts.inside_circle;
+		for (size_t i = 0; i < m_scratch.size(); ++i)
+		{
+			state.cells[i].inside += m_scratch[i].inside;
+			state.cells[i].total += m_scratch[i].total;
+		}
+	}
+	return live_workers;
+}
+
+uint32_t SharedRegion::totals(uint64_t &total_points, uint64_t &inside_circle) const
+{
+	total_points = 0;
+	inside_circle = 0;
+	uint32_t live_workers = 0;
+	for (uint32_t slot = 0; slot < slot_count(); ++slot)
+	{
+		uint64_t owner = std::atomic_ref<uint64_t>(slot_at(slot)->owner).load(std::memory_order_relaxed);
+		live_workers += owner != 0 && ProcessAlive(owner);
+
+		SharedSlot::Counts counts;
+		if (read_slot(slot, counts, nullptr))
+		{
+			total_points += counts.total_points;
+			inside_circle += counts.inside_circle;
+		}
+	}
+	return live_workers;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Sampler.h"
+
+#include <cstdint>
+#include <vector>
+
+// Header of a shared region file. Worker processes map the same file; each one owns a
+// slot for its counts, and anyone mapping the file can sum the slots into one estimate.
+// Fields are written once by the process that creates the file, then `ready` is set.
+struct SharedRegionHeader
+{
+	static constexpr char s_magic[8] = {'P', 'I', 'S', 'H', 'A', 'R', 'E', '\0'};
+	static constexpr uint32_t s_version = 1;
+	static constexpr uint32_t s_byte_order = 0x01020304;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t header_size;
+	uint32_t ready; // Accessed atomically
+	uint32_t size;
+	uint32_t seed;
+	uint32_t sampling_mode;
+	uint32_t tile_size;
+	uint32_t slot_count;
+	uint32_t reserved;
+	uint64_t cell_count;
+	uint64_t slot_offset;
+	uint64_t slot_stride;
+};
+
+// Start of each slot, followed by the cells of its two count buffers
+struct SharedSlot
+{
+	struct Counts
+	{
+		uint64_t next_sample;
+		uint64_t total_points;
+		uint64_t inside_circle;
+		uint64_t reserved;
+	};
+
+	uint64_t owner;	   // Process id of the worker using the slot, 0 when free; atomic
+	uint64_t sequence; // Number of publishes, atomic; the newest is in buffer (sequence - 1) & 1
+	uint64_t first_sample;
+	uint64_t reserved;
+	Counts counts[2];
+};
+
+// Aggregates the runs of several worker processes through a memory-mapped file.
+//
+// Slot k samples indices [k * slot_samples(), (k + 1) * slot_samples()), so the slots never
+// overlap: 2^48 indices each, or for Random and RandomExact, which repeat after 2^31
+// samples (see sample_period()), an equal share of that period. A worker stops at the end
+// of its slot's range. Each
+// slot holds cumulative counts, double-buffered: a worker writes the buffer readers are
+// not using, then bumps the slot's sequence. A worker that crashes mid-write leaves the
+// previous publish intact, and its slot keeps contributing those counts. The next worker
+// to claim the slot continues from them and redoes only the unpublished samples, so
+// nothing is ever counted twice.
+class SharedRegion
+{
+public:
+	static constexpr uint32_t s_slot_sample_shift = 48;
+
+	// Opens the region at `path`, creating it for the given grid size, seed and sampling
+	// mode with `slot_count` slots if it does not exist yet. An existing region must have
+	// been created with the same size, seed and mode.
+	bool open(const char *path, uint32_t size, uint32_t seed, SamplingMode mode, uint32_t slot_count);
+	// Opens an existing region, e.g. to view it
+	bool attach(const char *path);
+
+	uint32_t size() const { return header()->size; }
+	uint32_t seed() const { return header()->seed; }
+	SamplingMode sampling_mode() const { return (SamplingMode)header()->sampling_mode; }
+	uint32_t slot_count() const { return header()->slot_count; }
+	uint64_t slot_samples() const { return slot_samples(sampling_mode(), slot_count()); }
+	static uint64_t slot_samples(SamplingMode mode, uint32_t slot_count);
+
+	// Worker side. claim_slot() takes a free slot, or one whose worker has died, that has
+	// samples of its range left, and fills `state` with where that slot's run stands;
+	// restoring it into a Sampler continues the run. publish() then makes the sampler's
+	// counts visible, release() frees the slot.
+	bool claim_slot(SamplerState &state);
+	int32_t slot() const { return m_slot; }
+	// Sample index the claimed slot's range ends at
+	uint64_t slot_end() const { return slot_at((uint32_t)m_slot)->first_sample + slot_samples(); }
+	void publish(const Sampler &sampler);
+	void release();
+
+	// Reader side, consistent per slot. aggregate() sums the counts and cells of all slots
+	// into `state`, totals() only the counts. Both return the number of live workers.
+	uint32_t aggregate(SamplerState &state);
+	uint32_t totals(uint64_t &total_points, uint64_t &inside_circle) const;
+
+private:
+	SharedRegionHeader *header() const { return (SharedRegionHeader *)m_file.data(); }
+	SharedSlot *slot_at(uint32_t slot) const { return (SharedSlot *)(m_file.data() + header()->slot_offset + header()->slot_stride * slot); }
+	PixelCounts<uint64_t> *slot_cells(uint32_t slot, uint32_t buffer) const;
+
+	bool wait_ready(const char *path);
+	bool read_slot(uint32_t slot, SharedSlot::Counts &counts, PixelCounts<uint64_t> *cells) const;
+
+private:
+	// Slot headers sit alone in their page, cells start page-aligned
+	static constexpr uint64_t s_page_size = 4096;
+
+	MappedFile m_file;
+	int32_t m_slot = -1;
+	std::vector<PixelCounts<uint64_t>> m_scratch;
+};
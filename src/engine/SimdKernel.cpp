@@ -0,0 +1,317 @@
+#include "SimdKernel.h"
+#include "SimdKernelIsa.h"
+#include "GridLayout.h"
+#include "Random.h"
+#include "RandomPolicies.h"
+#include "Sequence.h"
+
+#include <atomic>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+static SimdLevel DetectSimdLevel()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	// libgcc also checks XCR0, so these are false when the OS does not save the wide registers
+	__builtin_cpu_init();
+	if (avx512_kernel() && __builtin_cpu_supports("avx512f"))
+		return SimdLevel::Avx512;
+	if (avx2_kernel() && __builtin_cpu_supports("avx2"))
+		return SimdLevel::Avx2;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 1);
+	bool os_saves_registers = (info[2] & (1 << 27)) != 0;
+	uint64_t xcr0 = os_saves_registers ? _xgetbv(0) : 0;
+	__cpuidex(info, 7, 0);
+	if (avx512_kernel() && (info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+		return SimdLevel::Avx512;
+	if (avx2_kernel() && (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+		return SimdLevel::Avx2;
+#endif
+	return SimdLevel::Scalar;
+}
+
+static std::atomic<SimdLevel> s_simd_level = simd_level_supported();
+
+SimdLevel simd_level()
+{
+	return s_simd_level.load(std::memory_order_relaxed);
+}
+
+SimdLevel simd_level_supported()
+{
+	static const SimdLevel supported = DetectSimdLevel();
+	return supported;
+}
+
+const char *simd_level_name(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Avx512:
+		return "avx512";
+	case SimdLevel::Avx2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+void set_simd_level(SimdLevel level)
+{
+	if (level > simd_level_supported())
+		level = simd_level_supported();
+	s_simd_level.store(level, std::memory_order_relaxed);
+}
+
+static const IsaKernel *ActiveKernel()
+{
+	switch (simd_level())
+	{
+	case SimdLevel::Avx512:
+		return avx512_kernel();
+	case SimdLevel::Avx2:
+		return avx2_kernel();
+	default:
+		return nullptr;
+	}
+}
+
+static LaneStreams MakeLaneStreams(uint32_t seed, uint64_t first_sample, uint32_t lanes)
+{
+	LaneStreams streams = {};
+	uint32_t state = random_advance(seed, first_sample * 2);
+	for (uint32_t lane = 0; lane < lanes; ++lane)
+	{
+		streams.states[lane] = state;
+		state = random_advance(state, 2);
+	}
+	RandomJump jump = random_jump((uint64_t)lanes * 2);
+	streams.jump_multiplier = jump.multiplier;
+	streams.jump_increment = jump.increment;
+	return streams;
+}
+
+static inline bool IsInside(float x_coord, float y_coord)
+{
+	x_coord = x_coord * 2.0f - 1.0f;
+	y_coord = y_coord * 2.0f - 1.0f;
+	return x_coord * x_coord + y_coord * y_coord <= 1.0f;
+}
+
+uint64_t count_inside(uint32_t seed, uint64_t first_sample, uint64_t count)
+{
+	uint64_t inside = 0;
+	uint64_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel())
+	{
+		uint64_t iterations = count / kernel->lanes;
+		if (iterations > 0)
+			inside += kernel->count_inside(MakeLaneStreams(seed, first_sample, kernel->lanes), iterations);
+		done = iterations * kernel->lanes;
+	}
+
+	uint32_t rng_state = random_advance(seed, (first_sample + done) * 2);
+	for (uint64_t i = done; i < count; ++i)
+	{
+		float x_coord = random_float(rng_state);
+		float y_coord = random_float(rng_state);
+		inside += IsInside(x_coord, y_coord);
+	}
+	return inside;
+}
+
+void classify_points(uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	uint32_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel())
+	{
+		uint32_t iterations = count / kernel->lanes;
+		if (iterations > 0)
+			kernel->classify(MakeLaneStreams(seed, first_sample, kernel->lanes), iterations, size, cell_indices, inside);
+		done = iterations * kernel->lanes;
+	}
+
+	int texture_width = (int)size;
+	int texture_height = (int)size;
+	uint32_t tiles_per_row = GridLayout::tiles_per_row(size);
+	uint32_t rng_state = random_advance(seed, (first_sample + done) * 2);
+	for (uint32_t i = done; i < count; ++i)
+	{
+		float x_coord = random_float(rng_state);
+		float y_coord = random_float(rng_state);
+		int x = (int)(x_coord * texture_width);
+		int y = (int)(y_coord * texture_height);
+
+		// Clamp to prevent out-of-bounds (only happens when coord is exactly 1.0)
+		if (x >= texture_width)
+			x = texture_width - 1;
+		if (y >= texture_height)
+			y = texture_height - 1;
+
+		cell_indices[i] = GridLayout::cell_index((uint32_t)x, (uint32_t)y, tiles_per_row);
+		inside[i] = IsInside(x_coord, y_coord);
+	}
+}
+
+// |2h + 1 - 2^32| = 2d + 1 is how far the middle of draw h's cell is from the center of
+// the square, in units of 2^-32
+static inline uint32_t CenterDistance(uint32_t bits)
+{
+	return (bits ^ ((bits >> 31) - 1)) & 0x7fffffffu;
+}
+
+// x^2 + y^2 <= 1 is (2dx + 1)^2 + (2dy + 1)^2 <= 2^64, i.e. dx(dx + 1) + dy(dy + 1) < 2^62.
+// The sum of odd squares is 2 mod 8, so it never equals 2^64.
+static inline bool IsInsideExact(uint32_t x_bits, uint32_t y_bits)
+{
+	uint64_t dx = CenterDistance(x_bits);
+	uint64_t dy = CenterDistance(y_bits);
+	return dx * (dx + 1) + dy * (dy + 1) < (1ull << 62);
+}
+
+uint64_t count_inside_exact(uint32_t seed, uint64_t first_sample, uint64_t count)
+{
+	uint64_t inside = 0;
+	uint64_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel())
+	{
+		uint64_t iterations = count / kernel->lanes;
+		if (iterations > 0)
+			inside += kernel->count_inside_exact(MakeLaneStreams(seed, first_sample, kernel->lanes), iterations);
+		done = iterations * kernel->lanes;
+	}
+
+	uint32_t rng_state = random_advance(seed, (first_sample + done) * 2);
+	for (uint64_t i = done; i < count; ++i)
+	{
+		uint32_t x_bits = random_bits(rng_state);
+		uint32_t y_bits = random_bits(rng_state);
+		inside += IsInsideExact(x_bits, y_bits);
+	}
+	return inside;
+}
+
+// SizeShift is log2 of a power-of-two grid size, with a constant grid width; 0 handles
+// any size
+template <uint32_t SizeShift>
+static void ClassifyExact(uint32_t rng_state, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	uint32_t tiles_per_row = GridLayout::tiles_per_row(SizeShift ? 1u << SizeShift : size);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t x_bits = random_bits(rng_state);
+		uint32_t y_bits = random_bits(rng_state);
+		uint32_t x, y;
+		if constexpr (SizeShift == 0)
+		{
+			x = (uint32_t)(((uint64_t)x_bits * size) >> 32);
+			y = (uint32_t)(((uint64_t)y_bits * size) >> 32);
+		}
+		else
+		{
+			x = x_bits >> (32 - SizeShift);
+			y = y_bits >> (32 - SizeShift);
+		}
+		cell_indices[i] = GridLayout::cell_index(x, y, tiles_per_row);
+		inside[i] = IsInsideExact(x_bits, y_bits);
+	}
+}
+
+void classify_points_exact(uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	uint32_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel())
+	{
+		uint32_t iterations = count / kernel->lanes;
+		if (iterations > 0)
+			kernel->classify_exact(MakeLaneStreams(seed, first_sample, kernel->lanes), iterations, size, cell_indices, inside);
+		done = iterations * kernel->lanes;
+	}
+	if (done == count)
+		return;
+
+	uint32_t rng_state = random_advance(seed, (first_sample + done) * 2);
+	count -= done;
+	cell_indices += done;
+	inside += done;
+	// One instance per grid preset of the viewer
+	switch (size)
+	{
+	case 1u << 3:
+		return ClassifyExact<3>(rng_state, count, size, cell_indices, inside);
+	case 1u << 4:
+		return ClassifyExact<4>(rng_state, count, size, cell_indices, inside);
+	case 1u << 5:
+		return ClassifyExact<5>(rng_state, count, size, cell_indices, inside);
+	case 1u << 6:
+		return ClassifyExact<6>(rng_state, count, size, cell_indices, inside);
+	case 1u << 9:
+		return ClassifyExact<9>(rng_state, count, size, cell_indices, inside);
+	case 1u << 10:
+		return ClassifyExact<10>(rng_state, count, size, cell_indices, inside);
+	case 1u << 11:
+		return ClassifyExact<11>(rng_state, count, size, cell_indices, inside);
+	case 1u << 12:
+		return ClassifyExact<12>(rng_state, count, size, cell_indices, inside);
+	case 1u << 13:
+		return ClassifyExact<13>(rng_state, count, size, cell_indices, inside);
+	default:
+		return ClassifyExact<0>(rng_state, count, size, cell_indices, inside);
+	}
+}
+
+void count_inside_batch(const uint32_t *seeds, uint32_t estimators, uint64_t first_sample, uint64_t count, bool exact, uint64_t *inside)
+{
+	uint32_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel(); kernel && count > 0)
+	{
+		// Whole vectors only, the last few estimators take the scalar loop
+		uint32_t vectors = estimators / kernel->lanes;
+		done = vectors * kernel->lanes;
+		std::vector<uint32_t> states(done);
+		for (uint32_t k = 0; k < done; ++k)
+		{
+			states[k] = random_advance(seeds[k], first_sample * 2);
+			inside[k] = 0;
+		}
+		if (vectors > 0)
+			kernel->count_inside_batch(states.data(), vectors, count, exact, inside);
+	}
+
+	for (uint32_t k = done; k < estimators; ++k)
+		inside[k] = exact ? count_inside_exact(seeds[k], first_sample, count) : count_inside(seeds[k], first_sample, count);
+}
+
+void count_inside_philox_batch(const uint32_t *seeds, uint32_t estimators, uint64_t first_sample, uint64_t count, uint64_t *inside)
+{
+	static_assert(PhiloxLanes::s_rounds == Philox4x32::s_rounds);
+	uint32_t done = 0;
+	if (const IsaKernel *kernel = ActiveKernel(); kernel && count > 0)
+	{
+		PhiloxLanes lanes;
+		lanes.multipliers[0] = Philox4x32::s_multiplier0;
+		lanes.multipliers[1] = Philox4x32::s_multiplier1;
+		for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+			lanes.key_high[round] = Philox4x32::s_key_high + round * Philox4x32::s_key_step1;
+
+		// Whole vectors only, the last few estimators take the scalar loop
+		for (; done + kernel->lanes <= estimators; done += kernel->lanes)
+		{
+			for (uint32_t lane = 0; lane < kernel->lanes; ++lane)
+			{
+				for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+					lanes.key_low[round][lane] = seeds[done + lane] + round * Philox4x32::s_key_step0;
+				inside[done + lane] = 0;
+			}
+			kernel->count_inside_philox(lanes, first_sample, count, inside + done);
+		}
+	}
+
+	for (uint32_t k = done; k < estimators; ++k)
+		inside[k] = count_inside_sequence(SamplingMode::Philox, seeds[k], first_sample, count);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+enum class SimdLevel
+{
+	Scalar,
+	Avx2,
+	Avx512,
+};
+
+// Widest kernel the CPU, the OS and the build all support, detected on first use
+SimdLevel simd_level();
+SimdLevel simd_level_supported();
+const char *simd_level_name(SimdLevel level);
+
+// Forces a narrower kernel (clamped to what is supported), e.g. to compare throughput
+void set_simd_level(SimdLevel level);
+
+// The kernels below reproduce Sampler's scalar math bit for bit: sample i of the sequence
+// seeded with `seed` is the point (random_float(), random_float()) after 2i draws, and it
+// is inside when x*x + y*y <= 1 with x, y remapped to [-1, 1].
+
+// Number of samples in [first_sample, first_sample + count) that land inside the circle
+uint64_t count_inside(uint32_t seed, uint64_t first_sample, uint64_t count);
+
+// Writes each sample's cell index in a size x size grid stored as in GridLayout, and a
+// 0/1 inside flag
+void classify_points(uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside);
+
+// Integer versions of the two kernels above, for SamplingMode::RandomExact, on the same
+// draws. A 32-bit draw h stands for the middle of its 2^-32 wide cell: the pixel is
+// floor(h * size / 2^32), simply the high bits for power-of-two sizes, and the inside test
+// is an exact integer compare with no rounding near the circle. No point lies exactly on it.
+uint64_t count_inside_exact(uint32_t seed, uint64_t first_sample, uint64_t count);
+void classify_points_exact(uint32_t seed, uint64_t first_sample, uint32_t count, uint32_t size, uint32_t *cell_indices, uint32_t *inside);
+
+// Independent runs counted together, for variance studies: inside[k] is set to what
+// count_inside() (or count_inside_exact() if `exact`) gives for seeds[k]. The SIMD kernels
+// hold one estimator per lane instead of consecutive samples of one run.
+void count_inside_batch(const uint32_t *seeds, uint32_t estimators, uint64_t first_sample, uint64_t count, bool exact, uint64_t *inside);
+
+// The same for SamplingMode::Philox: inside[k] is set to what count_inside_sequence() in
+// Sequence.h gives for seeds[k]. Each lane computes the same block under its own key, and
+// tests the point in double exactly like the scalar code.
+void count_inside_philox_batch(const uint32_t *seeds, uint32_t estimators, uint64_t first_sample, uint64_t count, uint64_t *inside);
@@ -0,0 +1,421 @@
+#include "SimdKernelIsa.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+static inline __m256i step8(__m256i state)
+{
+	return _mm256_add_epi32(_mm256_mullo_epi32(state, _mm256_set1_epi32(747796405)), _mm256_set1_epi32((int)2891336453u));
+}
+
+static inline __m256i hash8(__m256i state)
+{
+	__m256i shift = _mm256_add_epi32(_mm256_srli_epi32(state, 28), _mm256_set1_epi32(4));
+	__m256i result = _mm256_mullo_epi32(_mm256_xor_si256(_mm256_srlv_epi32(state, shift), state), _mm256_set1_epi32(277803737));
+	return _mm256_xor_si256(_mm256_srli_epi32(result, 22), result);
+}
+
+// Exact uint32 -> float like the scalar cast (AVX2 only converts signed integers),
+// then / 4294967295.0f, which is exactly 2^-32 in float
+static inline __m256 unit8(__m256i bits)
+{
+	__m256 high = _mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 16));
+	__m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0xFFFF)));
+	__m256 value = _mm256_add_ps(_mm256_mul_ps(high, _mm256_set1_ps(65536.0f)), low);
+	return _mm256_mul_ps(value, _mm256_set1_ps(0x1p-32f));
+}
+
+static inline __m256 inside8(__m256 x, __m256 y)
+{
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 two = _mm256_set1_ps(2.0f);
+	__m256 dx = _mm256_sub_ps(_mm256_mul_ps(x, two), one);
+	__m256 dy = _mm256_sub_ps(_mm256_mul_ps(y, two), one);
+	__m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+	return _mm256_cmp_ps(distance, one, _CMP_LE_OQ);
+}
+
+static uint64_t count_inside_avx2(const LaneStreams &streams, uint64_t iterations)
+{
+	__m256i state = _mm256_loadu_si256((const __m256i *)streams.states);
+	__m256i jump_multiplier = _mm256_set1_epi32((int)streams.jump_multiplier);
+	__m256i jump_increment = _mm256_set1_epi32((int)streams.jump_increment);
+
+	uint64_t inside = 0;
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m256i counts = _mm256_setzero_si256();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			__m256i x_state = step8(state);
+			__m256i y_state = step8(x_state);
+			__m256 mask = inside8(unit8(hash8(x_state)), unit8(hash8(y_state)));
+			counts = _mm256_sub_epi32(counts, _mm256_castps_si256(mask));
+			state = _mm256_add_epi32(_mm256_mullo_epi32(state, jump_multiplier), jump_increment);
+		}
+
+		alignas(32) uint32_t lanes[8];
+		_mm256_store_si256((__m256i *)lanes, counts);
+		for (uint32_t lane : lanes)
+			inside += lane;
+		iterations -= chunk;
+	}
+	return inside;
+}
+
+static void classify_avx2(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	__m256i state = _mm256_loadu_si256((const __m256i *)streams.states);
+	__m256i jump_multiplier = _mm256_set1_epi32((int)streams.jump_multiplier);
+	__m256i jump_increment = _mm256_set1_epi32((int)streams.jump_increment);
+	__m256 size_f = _mm256_set1_ps((float)size);
+	__m256i max_coord = _mm256_set1_epi32((int)size - 1);
+	__m256i tiles_per_row = _mm256_set1_epi32((int)((size + GridLayout::s_tile_size - 1) >> GridLayout::s_tile_shift));
+	__m256i in_tile_mask = _mm256_set1_epi32((int)GridLayout::s_tile_size - 1);
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		__m256i x_state = step8(state);
+		__m256i y_state = step8(x_state);
+		__m256 x = unit8(hash8(x_state));
+		__m256 y = unit8(hash8(y_state));
+
+		// Clamp to prevent out-of-bounds (only happens when coord is exactly 1.0)
+		__m256i pixel_x = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(x, size_f)), max_coord);
+		__m256i pixel_y = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(y, size_f)), max_coord);
+		__m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row), _mm256_srli_epi32(pixel_x, GridLayout::s_tile_shift));
+		__m256i in_tile = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(pixel_y, in_tile_mask), GridLayout::s_tile_shift), _mm256_and_si256(pixel_x, in_tile_mask));
+		__m256i cell_index = _mm256_or_si256(_mm256_slli_epi32(tile, GridLayout::s_tile_cell_shift), in_tile);
+		__m256i flag = _mm256_srli_epi32(_mm256_castps_si256(inside8(x, y)), 31);
+
+		_mm256_storeu_si256((__m256i *)(cell_indices + i * 8), cell_index);
+		_mm256_storeu_si256((__m256i *)(inside + i * 8), flag);
+		state = _mm256_add_epi32(_mm256_mullo_epi32(state, jump_multiplier), jump_increment);
+	}
+}
+
+// See CenterDistance() and IsInsideExact() in SimdKernel.cpp
+static inline __m256i center_distance8(__m256i bits)
+{
+	__m256i flip = _mm256_sub_epi32(_mm256_srli_epi32(bits, 31), _mm256_set1_epi32(1));
+	return _mm256_and_si256(_mm256_xor_si256(bits, flip), _mm256_set1_epi32(0x7fffffff));
+}
+
+// The integer test, all ones in the lanes inside. The products are 64-bit, so even and odd
+// lanes are computed apart; the sums stay below 2^63, so bit 62 alone tells whether they
+// reach 2^62.
+static inline __m256i inside_integer8(__m256i x_bits, __m256i y_bits)
+{
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i dx = center_distance8(x_bits);
+	__m256i dy = center_distance8(y_bits);
+	__m256i dx_next = _mm256_add_epi32(dx, one);
+	__m256i dy_next = _mm256_add_epi32(dy, one);
+	__m256i even = _mm256_add_epi64(_mm256_mul_epu32(dx, dx_next), _mm256_mul_epu32(dy, dy_next));
+	__m256i odd = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(dx, 32), _mm256_srli_epi64(dx_next, 32)),
+		_mm256_mul_epu32(_mm256_srli_epi64(dy, 32), _mm256_srli_epi64(dy_next, 32)));
+	__m256i outside = _mm256_or_si256(_mm256_srli_epi64(even, 62), _mm256_and_si256(_mm256_srli_epi64(odd, 30), _mm256_set1_epi64x(1ll << 32)));
+	return _mm256_cmpeq_epi32(outside, _mm256_setzero_si256());
+}
+
+// Same result as the integer test, mostly without its 64-bit products: a float estimate of
+// the squared distance, scaled by 2^62, decides every lane but the ones within a few float
+// roundings of the circle. Those are about one vector in 40000 and take the integer test.
+static inline __m256i inside_exact8(__m256i x_bits, __m256i y_bits)
+{
+	__m256i sign = _mm256_set1_epi32((int)0x80000000u);
+	__m256 x = _mm256_cvtepi32_ps(_mm256_xor_si256(x_bits, sign));
+	__m256 y = _mm256_cvtepi32_ps(_mm256_xor_si256(y_bits, sign));
+	__m256 distance = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+	__m256 inside = _mm256_cmp_ps(distance, _mm256_set1_ps(0x1p62f - 0x1p44f), _CMP_LT_OQ);
+	__m256 outside = _mm256_cmp_ps(distance, _mm256_set1_ps(0x1p62f + 0x1p44f), _CMP_GT_OQ);
+	if (_mm256_movemask_ps(_mm256_or_ps(inside, outside)) != 0xff)
+		return inside_integer8(x_bits, y_bits);
+	return _mm256_castps_si256(inside);
+}
+
+// floor(bits * size / 2^32) per lane
+static inline __m256i scale8(__m256i bits, __m256i size)
+{
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epu32(bits, size), 32);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(bits, 32), size);
+	return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+static uint64_t count_inside_exact_avx2(const LaneStreams &streams, uint64_t iterations)
+{
+	__m256i state = _mm256_loadu_si256((const __m256i *)streams.states);
+	__m256i jump_multiplier = _mm256_set1_epi32((int)streams.jump_multiplier);
+	__m256i jump_increment = _mm256_set1_epi32((int)streams.jump_increment);
+
+	uint64_t inside = 0;
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m256i counts = _mm256_setzero_si256();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			__m256i x_state = step8(state);
+			__m256i y_state = step8(x_state);
+			counts = _mm256_sub_epi32(counts, inside_exact8(hash8(x_state), hash8(y_state)));
+			state = _mm256_add_epi32(_mm256_mullo_epi32(state, jump_multiplier), jump_increment);
+		}
+
+		alignas(32) uint32_t lanes[8];
+		_mm256_store_si256((__m256i *)lanes, counts);
+		for (uint32_t lane : lanes)
+			inside += lane;
+		iterations -= chunk;
+	}
+	return inside;
+}
+
+// SizeShift is log2 of a power-of-two grid size: pixels are the top bits and the grid
+// width is a constant. 0 handles any size.
+template <uint32_t SizeShift>
+static void classify_exact_avx2_sized(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	constexpr uint32_t tiles_per_row_shift = SizeShift > GridLayout::s_tile_shift ? SizeShift - GridLayout::s_tile_shift : 0;
+	__m256i state = _mm256_loadu_si256((const __m256i *)streams.states);
+	__m256i jump_multiplier = _mm256_set1_epi32((int)streams.jump_multiplier);
+	__m256i jump_increment = _mm256_set1_epi32((int)streams.jump_increment);
+	__m256i size_vector = _mm256_set1_epi32((int)size);
+	__m256i tiles_per_row = _mm256_set1_epi32((int)((size + GridLayout::s_tile_size - 1) >> GridLayout::s_tile_shift));
+	__m256i in_tile_mask = _mm256_set1_epi32((int)GridLayout::s_tile_size - 1);
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		__m256i x_state = step8(state);
+		__m256i y_state = step8(x_state);
+		__m256i x_bits = hash8(x_state);
+		__m256i y_bits = hash8(y_state);
+
+		__m256i pixel_x, pixel_y, tile_row;
+		if constexpr (SizeShift == 0)
+		{
+			pixel_x = scale8(x_bits, size_vector);
+			pixel_y = scale8(y_bits, size_vector);
+			tile_row = _mm256_mullo_epi32(_mm256_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row);
+		}
+		else
+		{
+			pixel_x = _mm256_srli_epi32(x_bits, 32 - SizeShift);
+			pixel_y = _mm256_srli_epi32(y_bits, 32 - SizeShift);
+			tile_row = _mm256_slli_epi32(_mm256_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row_shift);
+		}
+		__m256i tile = _mm256_add_epi32(tile_row, _mm256_srli_epi32(pixel_x, GridLayout::s_tile_shift));
+		__m256i in_tile = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(pixel_y, in_tile_mask), GridLayout::s_tile_shift), _mm256_and_si256(pixel_x, in_tile_mask));
+		__m256i cell_index = _mm256_or_si256(_mm256_slli_epi32(tile, GridLayout::s_tile_cell_shift), in_tile);
+		__m256i flag = _mm256_srli_epi32(inside_exact8(x_bits, y_bits), 31);
+
+		_mm256_storeu_si256((__m256i *)(cell_indices + i * 8), cell_index);
+		_mm256_storeu_si256((__m256i *)(inside + i * 8), flag);
+		state = _mm256_add_epi32(_mm256_mullo_epi32(state, jump_multiplier), jump_increment);
+	}
+}
+
+static void classify_exact_avx2(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	// One instance per grid preset of the viewer
+	switch (size)
+	{
+	case 1u << 3:
+		return classify_exact_avx2_sized<3>(streams, iterations, size, cell_indices, inside);
+	case 1u << 4:
+		return classify_exact_avx2_sized<4>(streams, iterations, size, cell_indices, inside);
+	case 1u << 5:
+		return classify_exact_avx2_sized<5>(streams, iterations, size, cell_indices, inside);
+	case 1u << 6:
+		return classify_exact_avx2_sized<6>(streams, iterations, size, cell_indices, inside);
+	case 1u << 9:
+		return classify_exact_avx2_sized<9>(streams, iterations, size, cell_indices, inside);
+	case 1u << 10:
+		return classify_exact_avx2_sized<10>(streams, iterations, size, cell_indices, inside);
+	case 1u << 11:
+		return classify_exact_avx2_sized<11>(streams, iterations, size, cell_indices, inside);
+	case 1u << 12:
+		return classify_exact_avx2_sized<12>(streams, iterations, size, cell_indices, inside);
+	case 1u << 13:
+		return classify_exact_avx2_sized<13>(streams, iterations, size, cell_indices, inside);
+	default:
+		return classify_exact_avx2_sized<0>(streams, iterations, size, cell_indices, inside);
+	}
+}
+
+// Two LCG steps at once, from one sample's x draw state to the next one's
+static inline __m256i step_sample8(__m256i state)
+{
+	constexpr uint32_t multiplier = 747796405u * 747796405u;
+	constexpr uint32_t increment = 2891336453u * 747796405u + 2891336453u;
+	return _mm256_add_epi32(_mm256_mullo_epi32(state, _mm256_set1_epi32((int)multiplier)), _mm256_set1_epi32((int)increment));
+}
+
+// Every lane is its own run, so each step depends on the previous one; Vectors independent
+// vectors go together to hide that latency
+template <uint32_t Vectors, bool Exact>
+static void count_inside_batch_avx2_group(const uint32_t *states, uint64_t iterations, uint64_t *inside)
+{
+	__m256i state[Vectors];
+	for (uint32_t v = 0; v < Vectors; ++v)
+		state[v] = _mm256_loadu_si256((const __m256i *)(states + v * 8));
+
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m256i counts[Vectors];
+		for (uint32_t v = 0; v < Vectors; ++v)
+			counts[v] = _mm256_setzero_si256();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			for (uint32_t v = 0; v < Vectors; ++v)
+			{
+				__m256i x_state = step8(state[v]);
+				__m256i y_state = step_sample8(state[v]);
+				__m256i mask;
+				if constexpr (Exact)
+					mask = inside_exact8(hash8(x_state), hash8(y_state));
+				else
+					mask = _mm256_castps_si256(inside8(unit8(hash8(x_state)), unit8(hash8(y_state))));
+				counts[v] = _mm256_sub_epi32(counts[v], mask);
+				state[v] = y_state;
+			}
+		}
+
+		for (uint32_t v = 0; v < Vectors; ++v)
+		{
+			alignas(32) uint32_t lanes[8];
+			_mm256_store_si256((__m256i *)lanes, counts[v]);
+			for (uint32_t lane = 0; lane < 8; ++lane)
+				inside[v * 8 + lane] += lanes[lane];
+		}
+		iterations -= chunk;
+	}
+}
+
+template <bool Exact>
+static void count_inside_batch_avx2_exactness(const uint32_t *states, uint32_t vectors, uint64_t iterations, uint64_t *inside)
+{
+	for (uint32_t v = 0; v < vectors; v += 4)
+	{
+		switch (vectors - v)
+		{
+		case 1:
+			count_inside_batch_avx2_group<1, Exact>(states + v * 8, iterations, inside + v * 8);
+			break;
+		case 2:
+			count_inside_batch_avx2_group<2, Exact>(states + v * 8, iterations, inside + v * 8);
+			break;
+		case 3:
+			count_inside_batch_avx2_group<3, Exact>(states + v * 8, iterations, inside + v * 8);
+			break;
+		default:
+			count_inside_batch_avx2_group<4, Exact>(states + v * 8, iterations, inside + v * 8);
+			break;
+		}
+	}
+}
+
+static void count_inside_batch_avx2(const uint32_t *states, uint32_t vectors, uint64_t iterations, bool exact, uint64_t *inside)
+{
+	if (exact)
+		count_inside_batch_avx2_exactness<true>(states, vectors, iterations, inside);
+	else
+		count_inside_batch_avx2_exactness<false>(states, vectors, iterations, inside);
+}
+
+// Full 64-bit products of every lane with `multiplier`, as high and low words
+static inline void multiply8(__m256i words, __m256i multiplier, __m256i &high, __m256i &low)
+{
+	__m256i even = _mm256_mul_epu32(words, multiplier);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(words, 32), multiplier);
+	high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+	low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// IsInside() of Sequence.cpp: the top 53 bits go to double exactly, as two halves that are
+// each exact, then the same operations follow in the same order
+static inline __m256d coordinate4(__m256i bits)
+{
+	__m256i value = _mm256_srli_epi64(bits, 11);
+	__m256i exponent = _mm256_set1_epi64x(0x4330000000000000);
+	__m256d offset = _mm256_set1_pd(0x1p52);
+	__m256d high = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(value, 32), exponent)), offset);
+	__m256d low = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(value, _mm256_set1_epi64x(0xFFFFFFFF)), exponent)), offset);
+	__m256d exact = _mm256_add_pd(_mm256_mul_pd(high, _mm256_set1_pd(0x1p32)), low);
+	return _mm256_sub_pd(_mm256_mul_pd(_mm256_add_pd(exact, _mm256_set1_pd(0.5)), _mm256_set1_pd(0x1p-52)), _mm256_set1_pd(1.0));
+}
+
+static inline __m256i inside_double4(__m256i x_bits, __m256i y_bits)
+{
+	__m256d x = coordinate4(x_bits);
+	__m256d y = coordinate4(y_bits);
+	return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_set1_pd(1.0), _CMP_LE_OQ));
+}
+
+static void count_inside_philox_avx2(const PhiloxLanes &lanes, uint64_t first_sample, uint64_t iterations, uint64_t *inside)
+{
+	__m256i key_low[PhiloxLanes::s_rounds];
+	for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+		key_low[round] = _mm256_loadu_si256((const __m256i *)lanes.key_low[round]);
+	__m256i multiplier0 = _mm256_set1_epi32((int)lanes.multipliers[0]);
+	__m256i multiplier1 = _mm256_set1_epi32((int)lanes.multipliers[1]);
+
+	// Points are 64-bit, so the test takes the lanes in two halves of 4, interleaved as
+	// unpacklo / unpackhi leave them
+	__m256i counts_low = _mm256_setzero_si256();
+	__m256i counts_high = _mm256_setzero_si256();
+	for (uint64_t i = 0; i < iterations; ++i)
+	{
+		uint64_t counter = first_sample + i;
+		__m256i words0 = _mm256_set1_epi32((int)(uint32_t)counter);
+		__m256i words1 = _mm256_set1_epi32((int)(uint32_t)(counter >> 32));
+		__m256i words2 = _mm256_setzero_si256();
+		__m256i words3 = _mm256_setzero_si256();
+		for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+		{
+			__m256i high0, low0, high1, low1;
+			multiply8(words0, multiplier0, high0, low0);
+			multiply8(words2, multiplier1, high1, low1);
+			words0 = _mm256_xor_si256(_mm256_xor_si256(high1, words1), key_low[round]);
+			words2 = _mm256_xor_si256(_mm256_xor_si256(high0, words3), _mm256_set1_epi32((int)lanes.key_high[round]));
+			words1 = low1;
+			words3 = low0;
+		}
+		// All-ones per inside slot, so subtracting counts it
+		counts_low = _mm256_sub_epi64(counts_low, inside_double4(_mm256_unpacklo_epi32(words0, words1), _mm256_unpacklo_epi32(words2, words3)));
+		counts_high = _mm256_sub_epi64(counts_high, inside_double4(_mm256_unpackhi_epi32(words0, words1), _mm256_unpackhi_epi32(words2, words3)));
+	}
+
+	// Slot s of the low half is lane 4 * (s / 2) + s % 2 of each 128-bit block, the high
+	// half's are the two lanes after those
+	alignas(32) uint64_t low[4];
+	alignas(32) uint64_t high[4];
+	_mm256_store_si256((__m256i *)low, counts_low);
+	_mm256_store_si256((__m256i *)high, counts_high);
+	for (uint32_t slot = 0; slot < 4; ++slot)
+	{
+		inside[4 * (slot / 2) + slot % 2] += low[slot];
+		inside[4 * (slot / 2) + 2 + slot % 2] += high[slot];
+	}
+}
+
+const IsaKernel *avx2_kernel()
+{
+	static const IsaKernel kernel = {8, count_inside_avx2, classify_avx2, count_inside_exact_avx2, classify_exact_avx2, count_inside_batch_avx2,
+		count_inside_philox_avx2};
+	return &kernel;
+}
+
+#else
+
+const IsaKernel *avx2_kernel()
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,430 @@
+#include "SimdKernelIsa.h"
+
+#if defined(__AVX512F__)
+
+// GCC 12's avx512fintrin.h trips this on its own _mm512_undefined_* helpers
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+static inline __m512i step16(__m512i state)
+{
+	return _mm512_add_epi32(_mm512_mullo_epi32(state, _mm512_set1_epi32(747796405)), _mm512_set1_epi32((int)2891336453u));
+}
+
+static inline __m512i hash16(__m512i state)
+{
+	__m512i shift = _mm512_add_epi32(_mm512_srli_epi32(state, 28), _mm512_set1_epi32(4));
+	__m512i result = _mm512_mullo_epi32(_mm512_xor_si512(_mm512_srlv_epi32(state, shift), state), _mm512_set1_epi32(277803737));
+	return _mm512_xor_si512(_mm512_srli_epi32(result, 22), result);
+}
+
+// uint32 -> float is a single instruction here; / 4294967295.0f is exactly 2^-32 in float
+static inline __m512 unit16(__m512i bits)
+{
+	return _mm512_mul_ps(_mm512_cvtepu32_ps(bits), _mm512_set1_ps(0x1p-32f));
+}
+
+static inline __mmask16 inside16(__m512 x, __m512 y)
+{
+	__m512 one = _mm512_set1_ps(1.0f);
+	__m512 two = _mm512_set1_ps(2.0f);
+	__m512 dx = _mm512_sub_ps(_mm512_mul_ps(x, two), one);
+	__m512 dy = _mm512_sub_ps(_mm512_mul_ps(y, two), one);
+	__m512 distance = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+	return _mm512_cmp_ps_mask(distance, one, _CMP_LE_OQ);
+}
+
+static uint64_t count_inside_avx512(const LaneStreams &streams, uint64_t iterations)
+{
+	__m512i state = _mm512_loadu_si512(streams.states);
+	__m512i jump_multiplier = _mm512_set1_epi32((int)streams.jump_multiplier);
+	__m512i jump_increment = _mm512_set1_epi32((int)streams.jump_increment);
+	__m512i ones = _mm512_set1_epi32(1);
+
+	uint64_t inside = 0;
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m512i counts = _mm512_setzero_si512();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			__m512i x_state = step16(state);
+			__m512i y_state = step16(x_state);
+			__mmask16 mask = inside16(unit16(hash16(x_state)), unit16(hash16(y_state)));
+			counts = _mm512_mask_add_epi32(counts, mask, counts, ones);
+			state = _mm512_add_epi32(_mm512_mullo_epi32(state, jump_multiplier), jump_increment);
+		}
+
+		alignas(64) uint32_t lanes[16];
+		_mm512_store_si512(lanes, counts);
+		for (uint32_t lane : lanes)
+			inside += lane;
+		iterations -= chunk;
+	}
+	return inside;
+}
+
+static void classify_avx512(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	__m512i state = _mm512_loadu_si512(streams.states);
+	__m512i jump_multiplier = _mm512_set1_epi32((int)streams.jump_multiplier);
+	__m512i jump_increment = _mm512_set1_epi32((int)streams.jump_increment);
+	__m512 size_f = _mm512_set1_ps((float)size);
+	__m512i max_coord = _mm512_set1_epi32((int)size - 1);
+	__m512i tiles_per_row = _mm512_set1_epi32((int)((size + GridLayout::s_tile_size - 1) >> GridLayout::s_tile_shift));
+	__m512i in_tile_mask = _mm512_set1_epi32((int)GridLayout::s_tile_size - 1);
+	__m512i ones = _mm512_set1_epi32(1);
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		__m512i x_state = step16(state);
+		__m512i y_state = step16(x_state);
+		__m512 x = unit16(hash16(x_state));
+		__m512 y = unit16(hash16(y_state));
+
+		// Clamp to prevent out-of-bounds (only happens when coord is exactly 1.0)
+		__m512i pixel_x = _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(x, size_f)), max_coord);
+		__m512i pixel_y = _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(y, size_f)), max_coord);
+		__m512i tile = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row), _mm512_srli_epi32(pixel_x, GridLayout::s_tile_shift));
+		__m512i in_tile = _mm512_or_si512(_mm512_slli_epi32(_mm512_and_si512(pixel_y, in_tile_mask), GridLayout::s_tile_shift), _mm512_and_si512(pixel_x, in_tile_mask));
+		__m512i cell_index = _mm512_or_si512(_mm512_slli_epi32(tile, GridLayout::s_tile_cell_shift), in_tile);
+		__m512i flag = _mm512_maskz_mov_epi32(inside16(x, y), ones);
+
+		_mm512_storeu_si512(cell_indices + i * 16, cell_index);
+		_mm512_storeu_si512(inside + i * 16, flag);
+		state = _mm512_add_epi32(_mm512_mullo_epi32(state, jump_multiplier), jump_increment);
+	}
+}
+
+// See CenterDistance() and IsInsideExact() in SimdKernel.cpp
+static inline __m512i center_distance16(__m512i bits)
+{
+	__m512i low_bits = _mm512_set1_epi32(0x7fffffff);
+	__mmask16 lower_half = _mm512_cmpge_epi32_mask(bits, _mm512_setzero_si512());
+	return _mm512_and_si512(_mm512_mask_xor_epi32(bits, lower_half, bits, low_bits), low_bits);
+}
+
+// The integer test. The products are 64-bit, so the odd lanes are swapped into the even
+// positions and computed apart.
+static inline __mmask16 inside_integer16(__m512i x_bits, __m512i y_bits)
+{
+	__m512i one = _mm512_set1_epi32(1);
+	__m512i limit = _mm512_set1_epi64(1ll << 62);
+	__m512i dx = center_distance16(x_bits);
+	__m512i dy = center_distance16(y_bits);
+	__m512i dx_odd = _mm512_shuffle_epi32(dx, _MM_PERM_CDAB);
+	__m512i dy_odd = _mm512_shuffle_epi32(dy, _MM_PERM_CDAB);
+	__m512i even = _mm512_add_epi64(_mm512_mul_epu32(dx, _mm512_add_epi32(dx, one)), _mm512_mul_epu32(dy, _mm512_add_epi32(dy, one)));
+	__m512i odd = _mm512_add_epi64(_mm512_mul_epu32(dx_odd, _mm512_add_epi32(dx_odd, one)), _mm512_mul_epu32(dy_odd, _mm512_add_epi32(dy_odd, one)));
+	__m512i flags = _mm512_or_si512(_mm512_maskz_mov_epi64(_mm512_cmplt_epu64_mask(even, limit), _mm512_set1_epi64(1)),
+		_mm512_maskz_mov_epi64(_mm512_cmplt_epu64_mask(odd, limit), _mm512_set1_epi64(1ll << 32)));
+	return _mm512_test_epi32_mask(flags, flags);
+}
+
+// Same result as the integer test, mostly without its 64-bit products: a float estimate of
+// the squared distance, scaled by 2^62, decides every lane but the ones within a few float
+// roundings of the circle. Those are about one vector in 20000 and take the integer test.
+static inline __mmask16 inside_exact16(__m512i x_bits, __m512i y_bits)
+{
+	__m512i sign = _mm512_set1_epi32((int)0x80000000u);
+	__m512 x = _mm512_cvtepi32_ps(_mm512_xor_si512(x_bits, sign));
+	__m512 y = _mm512_cvtepi32_ps(_mm512_xor_si512(y_bits, sign));
+	__m512 distance = _mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y));
+	__mmask16 inside = _mm512_cmp_ps_mask(distance, _mm512_set1_ps(0x1p62f - 0x1p44f), _CMP_LT_OQ);
+	__mmask16 outside = _mm512_cmp_ps_mask(distance, _mm512_set1_ps(0x1p62f + 0x1p44f), _CMP_GT_OQ);
+	if ((uint16_t)(inside | outside) != 0xffff)
+		return inside_integer16(x_bits, y_bits);
+	return inside;
+}
+
+// floor(bits * size / 2^32) per lane
+static inline __m512i scale16(__m512i bits, __m512i size)
+{
+	__m512i even = _mm512_srli_epi64(_mm512_mul_epu32(bits, size), 32);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(bits, 32), size);
+	return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+}
+
+static uint64_t count_inside_exact_avx512(const LaneStreams &streams, uint64_t iterations)
+{
+	__m512i state = _mm512_loadu_si512(streams.states);
+	__m512i jump_multiplier = _mm512_set1_epi32((int)streams.jump_multiplier);
+	__m512i jump_increment = _mm512_set1_epi32((int)streams.jump_increment);
+	__m512i ones = _mm512_set1_epi32(1);
+
+	uint64_t inside = 0;
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m512i counts = _mm512_setzero_si512();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			__m512i x_state = step16(state);
+			__m512i y_state = step16(x_state);
+			counts = _mm512_mask_add_epi32(counts, inside_exact16(hash16(x_state), hash16(y_state)), counts, ones);
+			state = _mm512_add_epi32(_mm512_mullo_epi32(state, jump_multiplier), jump_increment);
+		}
+
+		alignas(64) uint32_t lanes[16];
+		_mm512_store_si512(lanes, counts);
+		for (uint32_t lane : lanes)
+			inside += lane;
+		iterations -= chunk;
+	}
+	return inside;
+}
+
+// SizeShift is log2 of a power-of-two grid size: pixels are the top bits and the grid
+// width is a constant. 0 handles any size.
+template <uint32_t SizeShift>
+static void classify_exact_avx512_sized(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	constexpr uint32_t tiles_per_row_shift = SizeShift > GridLayout::s_tile_shift ? SizeShift - GridLayout::s_tile_shift : 0;
+	__m512i state = _mm512_loadu_si512(streams.states);
+	__m512i jump_multiplier = _mm512_set1_epi32((int)streams.jump_multiplier);
+	__m512i jump_increment = _mm512_set1_epi32((int)streams.jump_increment);
+	__m512i size_vector = _mm512_set1_epi32((int)size);
+	__m512i tiles_per_row = _mm512_set1_epi32((int)((size + GridLayout::s_tile_size - 1) >> GridLayout::s_tile_shift));
+	__m512i in_tile_mask = _mm512_set1_epi32((int)GridLayout::s_tile_size - 1);
+	__m512i ones = _mm512_set1_epi32(1);
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		__m512i x_state = step16(state);
+		__m512i y_state = step16(x_state);
+		__m512i x_bits = hash16(x_state);
+		__m512i y_bits = hash16(y_state);
+
+		__m512i pixel_x, pixel_y, tile_row;
+		if constexpr (SizeShift == 0)
+		{
+			pixel_x = scale16(x_bits, size_vector);
+			pixel_y = scale16(y_bits, size_vector);
+			tile_row = _mm512_mullo_epi32(_mm512_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row);
+		}
+		else
+		{
+			pixel_x = _mm512_srli_epi32(x_bits, 32 - SizeShift);
+			pixel_y = _mm512_srli_epi32(y_bits, 32 - SizeShift);
+			tile_row = _mm512_slli_epi32(_mm512_srli_epi32(pixel_y, GridLayout::s_tile_shift), tiles_per_row_shift);
+		}
+		__m512i tile = _mm512_add_epi32(tile_row, _mm512_srli_epi32(pixel_x, GridLayout::s_tile_shift));
+		__m512i in_tile = _mm512_or_si512(_mm512_slli_epi32(_mm512_and_si512(pixel_y, in_tile_mask), GridLayout::s_tile_shift), _mm512_and_si512(pixel_x, in_tile_mask));
+		__m512i cell_index = _mm512_or_si512(_mm512_slli_epi32(tile, GridLayout::s_tile_cell_shift), in_tile);
+		__m512i flag = _mm512_maskz_mov_epi32(inside_exact16(x_bits, y_bits), ones);
+
+		_mm512_storeu_si512(cell_indices + i * 16, cell_index);
+		_mm512_storeu_si512(inside + i * 16, flag);
+		state = _mm512_add_epi32(_mm512_mullo_epi32(state, jump_multiplier), jump_increment);
+	}
+}
+
+static void classify_exact_avx512(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside)
+{
+	// One instance per grid preset of the viewer
+	switch (size)
+	{
+	case 1u << 3:
+		return classify_exact_avx512_sized<3>(streams, iterations, size, cell_indices, inside);
+	case 1u << 4:
+		return classify_exact_avx512_sized<4>(streams, iterations, size, cell_indices, inside);
+	case 1u << 5:
+		return classify_exact_avx512_sized<5>(streams, iterations, size, cell_indices, inside);
+	case 1u << 6:
+		return classify_exact_avx512_sized<6>(streams, iterations, size, cell_indices, inside);
+	case 1u << 9:
+		return classify_exact_avx512_sized<9>(streams, iterations, size, cell_indices, inside);
+	case 1u << 10:
+		return classify_exact_avx512_sized<10>(streams, iterations, size, cell_indices, inside);
+	case 1u << 11:
+		return classify_exact_avx512_sized<11>(streams, iterations, size, cell_indices, inside);
+	case 1u << 12:
+		return classify_exact_avx512_sized<12>(streams, iterations, size, cell_indices, inside);
+	case 1u << 13:
+		return classify_exact_avx512_sized<13>(streams, iterations, size, cell_indices, inside);
+	default:
+		return classify_exact_avx512_sized<0>(streams, iterations, size, cell_indices, inside);
+	}
+}
+
+// Two LCG steps at once, from one sample's x draw state to the next one's
+static inline __m512i step_sample16(__m512i state)
+{
+	constexpr uint32_t multiplier = 747796405u * 747796405u;
+	constexpr uint32_t increment = 2891336453u * 747796405u + 2891336453u;
+	return _mm512_add_epi32(_mm512_mullo_epi32(state, _mm512_set1_epi32((int)multiplier)), _mm512_set1_epi32((int)increment));
+}
+
+// Every lane is its own run, so each step depends on the previous one; Vectors independent
+// vectors go together to hide that latency
+template <uint32_t Vectors, bool Exact>
+static void count_inside_batch_avx512_group(const uint32_t *states, uint64_t iterations, uint64_t *inside)
+{
+	__m512i state[Vectors];
+	for (uint32_t v = 0; v < Vectors; ++v)
+		state[v] = _mm512_loadu_si512(states + v * 16);
+	__m512i ones = _mm512_set1_epi32(1);
+
+	while (iterations > 0)
+	{
+		// Per-lane 32-bit counters, flushed before they can overflow
+		uint64_t chunk = iterations < (1u << 24) ? iterations : (1u << 24);
+		__m512i counts[Vectors];
+		for (uint32_t v = 0; v < Vectors; ++v)
+			counts[v] = _mm512_setzero_si512();
+		for (uint64_t i = 0; i < chunk; ++i)
+		{
+			for (uint32_t v = 0; v < Vectors; ++v)
+			{
+				__m512i x_state = step16(state[v]);
+				__m512i y_state = step_sample16(state[v]);
+				__mmask16 mask;
+				if constexpr (Exact)
+					mask = inside_exact16(hash16(x_state), hash16(y_state));
+				else
+					mask = inside16(unit16(hash16(x_state)), unit16(hash16(y_state)));
+				counts[v] = _mm512_mask_add_epi32(counts[v], mask, counts[v], ones);
+				state[v] = y_state;
+			}
+		}
+
+		for (uint32_t v = 0; v < Vectors; ++v)
+		{
+			alignas(64) uint32_t lanes[16];
+			_mm512_store_si512(lanes, counts[v]);
+			for (uint32_t lane = 0; lane < 16; ++lane)
+				inside[v * 16 + lane] += lanes[lane];
+		}
+		iterations -= chunk;
+	}
+}
+
+template <bool Exact>
+static void count_inside_batch_avx512_exactness(const uint32_t *states, uint32_t vectors, uint64_t iterations, uint64_t *inside)
+{
+	for (uint32_t v = 0; v < vectors; v += 4)
+	{
+		switch (vectors - v)
+		{
+		case 1:
+			count_inside_batch_avx512_group<1, Exact>(states + v * 16, iterations, inside + v * 16);
+			break;
+		case 2:
+			count_inside_batch_avx512_group<2, Exact>(states + v * 16, iterations, inside + v * 16);
+			break;
+		case 3:
+			count_inside_batch_avx512_group<3, Exact>(states + v * 16, iterations, inside + v * 16);
+			break;
+		default:
+			count_inside_batch_avx512_group<4, Exact>(states + v * 16, iterations, inside + v * 16);
+			break;
+		}
+	}
+}
+
+static void count_inside_batch_avx512(const uint32_t *states, uint32_t vectors, uint64_t iterations, bool exact, uint64_t *inside)
+{
+	if (exact)
+		count_inside_batch_avx512_exactness<true>(states, vectors, iterations, inside);
+	else
+		count_inside_batch_avx512_exactness<false>(states, vectors, iterations, inside);
+}
+
+// Full 64-bit products of every lane with `multiplier`, as high and low words
+static inline void multiply16(__m512i words, __m512i multiplier, __m512i &high, __m512i &low)
+{
+	__m512i even = _mm512_mul_epu32(words, multiplier);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(words, 32), multiplier);
+	high = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+	low = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+}
+
+// IsInside() of Sequence.cpp: the top 53 bits go to double exactly, as two halves that are
+// each exact, then the same operations follow in the same order
+static inline __m512d coordinate8(__m512i bits)
+{
+	__m512i value = _mm512_srli_epi64(bits, 11);
+	__m512i exponent = _mm512_set1_epi64(0x4330000000000000);
+	__m512d offset = _mm512_set1_pd(0x1p52);
+	__m512d high = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(value, 32), exponent)), offset);
+	__m512d low = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(value, _mm512_set1_epi64(0xFFFFFFFF)), exponent)), offset);
+	__m512d exact = _mm512_add_pd(_mm512_mul_pd(high, _mm512_set1_pd(0x1p32)), low);
+	return _mm512_sub_pd(_mm512_mul_pd(_mm512_add_pd(exact, _mm512_set1_pd(0.5)), _mm512_set1_pd(0x1p-52)), _mm512_set1_pd(1.0));
+}
+
+static inline __mmask8 inside_double8(__m512i x_bits, __m512i y_bits)
+{
+	__m512d x = coordinate8(x_bits);
+	__m512d y = coordinate8(y_bits);
+	return _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y)), _mm512_set1_pd(1.0), _CMP_LE_OQ);
+}
+
+static void count_inside_philox_avx512(const PhiloxLanes &lanes, uint64_t first_sample, uint64_t iterations, uint64_t *inside)
+{
+	__m512i key_low[PhiloxLanes::s_rounds];
+	for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+		key_low[round] = _mm512_loadu_si512(lanes.key_low[round]);
+	__m512i multiplier0 = _mm512_set1_epi32((int)lanes.multipliers[0]);
+	__m512i multiplier1 = _mm512_set1_epi32((int)lanes.multipliers[1]);
+	__m512i one = _mm512_set1_epi64(1);
+
+	// Points are 64-bit, so the test takes the lanes in two halves of 8, interleaved as
+	// unpacklo / unpackhi leave them
+	__m512i counts_low = _mm512_setzero_si512();
+	__m512i counts_high = _mm512_setzero_si512();
+	for (uint64_t i = 0; i < iterations; ++i)
+	{
+		uint64_t counter = first_sample + i;
+		__m512i words0 = _mm512_set1_epi32((int)(uint32_t)counter);
+		__m512i words1 = _mm512_set1_epi32((int)(uint32_t)(counter >> 32));
+		__m512i words2 = _mm512_setzero_si512();
+		__m512i words3 = _mm512_setzero_si512();
+		for (uint32_t round = 0; round < PhiloxLanes::s_rounds; ++round)
+		{
+			__m512i high0, low0, high1, low1;
+			multiply16(words0, multiplier0, high0, low0);
+			multiply16(words2, multiplier1, high1, low1);
+			words0 = _mm512_xor_si512(_mm512_xor_si512(high1, words1), key_low[round]);
+			words2 = _mm512_xor_si512(_mm512_xor_si512(high0, words3), _mm512_set1_epi32((int)lanes.key_high[round]));
+			words1 = low1;
+			words3 = low0;
+		}
+		__mmask8 mask_low = inside_double8(_mm512_unpacklo_epi32(words0, words1), _mm512_unpacklo_epi32(words2, words3));
+		__mmask8 mask_high = inside_double8(_mm512_unpackhi_epi32(words0, words1), _mm512_unpackhi_epi32(words2, words3));
+		counts_low = _mm512_mask_add_epi64(counts_low, mask_low, counts_low, one);
+		counts_high = _mm512_mask_add_epi64(counts_high, mask_high, counts_high, one);
+	}
+
+	// Slot s of the low half is lane 4 * (s / 2) + s % 2 of each 128-bit block, the high
+	// half's are the two lanes after those
+	alignas(64) uint64_t low[8];
+	alignas(64) uint64_t high[8];
+	_mm512_store_si512(low, counts_low);
+	_mm512_store_si512(high, counts_high);
+	for (uint32_t slot = 0; slot < 8; ++slot)
+	{
+		inside[4 * (slot / 2) + slot % 2] += low[slot];
+		inside[4 * (slot / 2) + 2 + slot % 2] += high[slot];
+	}
+}
+
+const IsaKernel *avx512_kernel()
+{
+	static const IsaKernel kernel = {16, count_inside_avx512, classify_avx512, count_inside_exact_avx512, classify_exact_avx512, count_inside_batch_avx512,
+		count_inside_philox_avx512};
+	return &kernel;
+}
+
+#else
+
+const IsaKernel *avx512_kernel()
+{
+	return nullptr;
+}
+
+#endif
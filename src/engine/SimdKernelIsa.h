@@ -0,0 +1,51 @@
+#pragma once
+
+// Interface between the dispatcher and the per-ISA translation units. Those are compiled
+// with -mavx2 / -mavx512f, so they only share plain data with the rest of the engine:
+// any inline function they instantiate could otherwise leak wide instructions into
+// code that runs on older CPUs.
+
+#include "GridLayout.h"
+
+#include <cstdint>
+
+struct LaneStreams
+{
+	// LCG state of lane l before the x draw of its first sample
+	uint32_t states[16];
+	// Advances every lane by one vector width of samples
+	uint32_t jump_multiplier;
+	uint32_t jump_increment;
+};
+
+// Philox4x32-10 for one key per lane, all lanes on the same counter. The dispatcher fills
+// in the round keys, so the constants stay in RandomPolicies.h.
+struct PhiloxLanes
+{
+	static constexpr uint32_t s_rounds = 10;
+
+	uint32_t key_low[s_rounds][16]; // Per lane
+	uint32_t key_high[s_rounds];
+	uint32_t multipliers[2];
+};
+
+struct IsaKernel
+{
+	uint32_t lanes;
+	uint64_t (*count_inside)(const LaneStreams &streams, uint64_t iterations);
+	void (*classify)(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside);
+	// Integer versions, see count_inside_exact()
+	uint64_t (*count_inside_exact)(const LaneStreams &streams, uint64_t iterations);
+	void (*classify_exact)(const LaneStreams &streams, uint32_t iterations, uint32_t size, uint32_t *cell_indices, uint32_t *inside);
+	// One estimator per lane, see count_inside_batch(): `states` holds vectors * lanes LCG
+	// states, each before the x draw of its own stream, and each lane's count is added to
+	// `inside`
+	void (*count_inside_batch)(const uint32_t *states, uint32_t vectors, uint64_t iterations, bool exact, uint64_t *inside);
+	// One Philox run per lane, see count_inside_philox_batch(): samples [first_sample,
+	// first_sample + iterations) of one vector of keys, each lane's count added to `inside`
+	void (*count_inside_philox)(const PhiloxLanes &lanes, uint64_t first_sample, uint64_t iterations, uint64_t *inside);
+};
+
+// Null when the build did not enable the instruction set for its translation unit
+const IsaKernel *avx2_kernel();
+const IsaKernel *avx512_kernel();
@@ -0,0 +1,456 @@
+#include "Simulation.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+Simulation::Simulation(uint32_t size, uint32_t thread_count, uint32_t seed)
+	: m_sampler(size, thread_count, seed)
+{
+	m_controls.thread_count = m_sampler.thread_count();
+	m_thread = std::thread(&Simulation::thread_loop, this);
+}
+
+Simulation::~Simulation()
+{
+	change_controls([](Controls &controls) { controls.stop = true; });
+	m_thread.join();
+}
+
+void Simulation::set_running(bool running)
+{
+	change_controls([&](Controls &controls) { controls.running = running; });
+}
+
+void Simulation::set_batch_size(uint64_t batch_size)
+{
+	change_controls([&](Controls &controls) { controls.batch_size = batch_size > 0 ? batch_size : 1; });
+}
+
+void Simulation::set_batch_budget(double seconds)
+{
+	change_controls([&](Controls &controls) { controls.batch_budget = seconds > 0.0 ? seconds : 0.0; });
+}
+
+void Simulation::set_target_precision(double epsilon, double confidence)
+{
+	double z = confidence_z(confidence);
+	change_controls([&](Controls &controls) {
+		controls.target_precision = epsilon > 0.0 ? epsilon : 0.0;
+		controls.confidence = confidence;
+		controls.confidence_z = z;
+	});
+}
+
+void Simulation::set_thread_count(uint32_t thread_count)
+{
+	change_controls([&](Controls &controls) { controls.thread_count = thread_count; });
+}
+
+void Simulation::set_colors(Color inside, Color outside)
+{
+	change_controls([&](Controls &controls) {
+		controls.inside_color = inside;
+		controls.outside_color = outside;
+		controls.colors_changed = true;
+	});
+}
+
+void Simulation::set_sampling_mode(SamplingMode mode)
+{
+	change_controls([&](Controls &controls) {
+		controls.sampling_mode = mode;
+		controls.sampling_mode_changed = true;
+	});
+}
+
+void Simulation::set_sampling_strategy(SamplingStrategy strategy)
+{
+	change_controls([&](Controls &controls) {
+		controls.sampling_strategy = strategy;
+		controls.sampling_strategy_changed = true;
+	});
+}
+
+void Simulation::reset(uint32_t size)
+{
+	change_controls([&](Controls &controls) {
+		controls.reset_size = size;
+		controls.reset_requested = true;
+	});
+}
+
+void Simulation::set_display_size(uint32_t size)
+{
+	change_controls([&](Controls &controls) {
+		controls.display_size = size;
+		controls.display_size_changed = true;
+	});
+}
+
+void Simulation::restore(SamplerState state)
+{
+	auto shared_state = std::make_shared<SamplerState>(std::move(state));
+	change_controls([&](Controls &controls) { controls.restore_state = shared_state; });
+}
+
+void Simulation::set_checkpoint(std::string path, double interval_seconds)
+{
+	change_controls([&](Controls &controls) {
+		controls.checkpoint_path = std::move(path);
+		controls.checkpoint_interval = interval_seconds;
+	});
+}
+
+void Simulation::attach(std::string path)
+{
+	change_controls([&](Controls &controls) {
+		controls.attach_path = std::move(path);
+		controls.attach_changed = true;
+	});
+}
+
+void Simulation::set_frame_export(std::string prefix, ImageFormat format, uint64_t interval)
+{
+	change_controls([&](Controls &controls) {
+		controls.frame_prefix = std::move(prefix);
+		controls.frame_format = format;
+		controls.frame_interval = interval > 0 ? interval : 1;
+		controls.frame_export_changed = true;
+	});
+}
+
+void Simulation::set_metrics(MetricsServer *server)
+{
+	change_controls([&](Controls &controls) { controls.metrics = server; });
+}
+
+void Simulation::checkpoint_now()
+{
+	change_controls([](Controls &controls) { controls.checkpoint_requested = true; });
+}
+
+template <typename Update>
+void Simulation::change_controls(Update update)
+{
+	{
+		std::lock_guard lock(m_controls_mutex);
+		update(m_controls);
+		m_controls_changed.store(true, std::memory_order_release);
+	}
+	m_controls_wake.notify_one();
+}
+
+void Simulation::thread_loop()
+{
+	profile_set_thread_name("Simulation");
+
+	Controls controls;
+	{
+		std::lock_guard lock(m_controls_mutex);
+		controls = m_controls;
+	}
+	bool publish_now = true;
+	Clock::time_point last_publish = Clock::now();
+	uint64_t last_published_points = 0;
+	uint64_t batch_size = 0;
+	Clock::time_point last_checkpoint = Clock::now();
+	bool checkpoint_pending = false;
+	bool target_reached = false;
+	Clock::time_point last_shared_change = Clock::now();
+	double shared_rate = 0.0;
+
+	while (true)
+	{
+		if (m_controls_changed.load(std::memory_order_acquire))
+		{
+			{
+				std::lock_guard lock(m_controls_mutex);
+				controls = m_controls;
+				m_controls.colors_changed = false;
+				m_controls.sampling_mode_changed = false;
+				m_controls.sampling_strategy_changed = false;
+				m_controls.reset_requested = false;
+				m_controls.display_size_changed = false;
+				m_controls.restore_state = nullptr;
+				m_controls.checkpoint_requested = false;
+				m_controls.attach_changed = false;
+				m_controls.frame_export_changed = false;
+				m_controls_changed.store(false, std::memory_order_relaxed);
+			}
+			if (controls.stop)
+			{
+				// One last checkpoint, so a clean exit loses nothing
+				if (!controls.checkpoint_path.empty())
+				{
+					m_checkpoint_writer.wait();
+					submit_checkpoint(controls.checkpoint_path);
+					m_checkpoint_writer.wait();
+				}
+				return;
+			}
+
+			// Throughput measured with another thread count or grid size no longer applies
+			if (controls.thread_count != m_sampler.thread_count())
+				m_scheduler.reset();
+			m_sampler.set_thread_count(controls.thread_count);
+			m_scheduler.set_budget(controls.batch_budget);
+			if (controls.colors_changed)
+			{
+				m_sampler.set_colors(controls.inside_color, controls.outside_color);
+				m_sampler.touch_all_tiles();
+			}
+			if (controls.sampling_mode_changed)
+			{
+				m_sampler.set_sampling_mode(controls.sampling_mode);
+				m_scheduler.reset();
+				last_published_points = 0;
+			}
+			// The folded strategies only sample a quarter of the grid
+			if (controls.sampling_strategy_changed && m_sampler.set_sampling_strategy(controls.sampling_strategy))
+			{
+				m_scheduler.reset();
+				last_published_points = 0;
+			}
+			if (controls.reset_requested)
+			{
+				restart(controls.reset_size);
+				m_scheduler.reset();
+				last_published_points = 0;
+			}
+			// Summed from the grid when it is fine enough, a new run otherwise
+			bool display_restarted = controls.display_size_changed && !m_sampler.set_display_size(controls.display_size);
+			if (display_restarted)
+			{
+				restart(controls.display_size);
+				m_scheduler.reset();
+				last_published_points = 0;
+			}
+			if (controls.attach_changed)
+			{
+				m_region = nullptr;
+				m_shared_workers = 0;
+				if (!controls.attach_path.empty())
+				{
+					m_region = std::make_unique<SharedRegion>();
+					if (!m_region->attach(controls.attach_path.c_str()))
+						m_region = nullptr;
+				}
+				if (!m_region)
+					m_sampler.reset(m_sampler.size());
+				m_scheduler.reset();
+				last_published_points = 0;
+			}
+			// Nothing else holds the state once it was taken out of m_controls
+			bool restored = controls.restore_state && m_sampler.restore(std::move(*controls.restore_state));
+			if (restored)
+			{
+				m_scheduler.reset();
+				last_published_points = m_sampler.total_points();
+			}
+			checkpoint_pending |= controls.checkpoint_requested;
+			publish_now = true;
+
+			// Any of these starts the history over, from wherever the run now stands
+			if (controls.sampling_mode_changed || controls.sampling_strategy_changed || controls.reset_requested || display_restarted ||
+				controls.attach_changed || restored)
+			{
+				m_history.clear();
+				m_history.append(m_sampler.total_points(), m_sampler.inside_circle(), m_sampler.statistics(1.0));
+			}
+			if (controls.frame_export_changed)
+			{
+				// The old exporter finishes its queued frames first
+				m_frame_exporter = nullptr;
+				if (!controls.frame_prefix.empty())
+					m_frame_exporter = std::make_unique<FrameExporter>(controls.frame_prefix, controls.frame_format);
+				m_frame_interval = controls.frame_interval;
+			}
+			if (m_frame_exporter)
+				m_next_frame = (m_sampler.total_points() / m_frame_interval + 1) * m_frame_interval;
+		}
+
+		// Workers of an attached region are stopped by their own --epsilon
+		target_reached = controls.target_precision > 0.0 && !m_region &&
+			m_sampler.statistics(controls.confidence_z).half_width <= controls.target_precision;
+		// Random and RandomExact repeat after sample_period(), further samples add nothing
+		bool period_reached = !m_region && m_sampler.total_points() >= sample_period(m_sampler.sampling_mode());
+		if (controls.running && (target_reached || period_reached))
+		{
+			// Stays stopped until set_running(true), which only samples on if the target changed or
+			// the run restarted
+			controls.running = false;
+			{
+				std::lock_guard lock(m_controls_mutex);
+				m_controls.running = false;
+			}
+			m_target_stops++;
+			publish_now = true;
+		}
+
+		if (controls.running && m_region)
+		{
+			// The workers do the sampling, take over their combined counts
+			SamplerState state;
+			m_shared_workers = m_region->aggregate(state);
+			uint64_t previous_points = m_sampler.total_points();
+			m_sampler.restore(std::move(state));
+			m_history.append(m_sampler.total_points(), m_sampler.inside_circle(), m_sampler.statistics(1.0));
+			batch_size = 0;
+
+			// Workers publish less often than this polls, so rate the changes only
+			Clock::time_point now = Clock::now();
+			if (m_sampler.total_points() != previous_points)
+			{
+				double seconds = std::chrono::duration<double>(now - last_shared_change).count();
+				shared_rate = m_sampler.total_points() > previous_points ? (double)(m_sampler.total_points() - previous_points) / seconds : 0.0;
+				last_shared_change = now;
+			}
+			else if (m_shared_workers == 0)
+			{
+				shared_rate = 0.0;
+			}
+
+			std::unique_lock lock(m_controls_mutex);
+			m_controls_wake.wait_for(lock, s_attach_interval, [this] { return m_controls_changed.load(std::memory_order_relaxed); });
+		}
+		else if (controls.running)
+		{
+			batch_size = controls.batch_budget > 0.0 ? m_scheduler.next_batch() : controls.batch_size;
+			if (controls.target_precision > 0.0)
+			{
+				uint64_t needed = m_sampler.samples_for_precision(controls.target_precision, controls.confidence_z);
+				uint64_t missing = needed > m_sampler.total_points() ? needed - m_sampler.total_points() : 0;
+				batch_size = std::min(batch_size, std::max(missing, s_min_target_batch));
+			}
+			batch_size = std::min(batch_size, sample_period(m_sampler.sampling_mode()) - m_sampler.total_points());
+			if (m_frame_exporter)
+				batch_size = std::min(batch_size, m_next_frame - m_sampler.total_points());
+			Clock::time_point batch_start = Clock::now();
+			m_sampler.sample(batch_size);
+			m_scheduler.record(batch_size, std::chrono::duration<double>(Clock::now() - batch_start).count());
+			m_history.append(m_sampler.total_points(), m_sampler.inside_circle(), m_sampler.statistics(1.0));
+			if (m_frame_exporter && m_sampler.total_points() == m_next_frame)
+			{
+				m_frame_exporter->capture(m_sampler, m_next_frame / m_frame_interval);
+				m_next_frame += m_frame_interval;
+			}
+		}
+		else if (!publish_now)
+		{
+			std::unique_lock lock(m_controls_mutex);
+			m_controls_wake.wait(lock, [this] { return m_controls_changed.load(std::memory_order_relaxed); });
+
+			// Don't count the time spent paused against the next rate measurement
+			last_publish = Clock::now();
+			last_published_points = m_sampler.total_points();
+			continue;
+		}
+
+		Clock::time_point now = Clock::now();
+		if (!controls.checkpoint_path.empty() && !m_checkpoint_writer.busy())
+		{
+			bool due = controls.checkpoint_interval > 0.0 && std::chrono::duration<double>(now - last_checkpoint).count() >= controls.checkpoint_interval;
+			if (due || checkpoint_pending)
+			{
+				submit_checkpoint(controls.checkpoint_path);
+				last_checkpoint = now;
+				checkpoint_pending = false;
+			}
+		}
+
+		if (publish_now || now - last_publish >= s_publish_interval)
+		{
+			double seconds = std::chrono::duration<double>(now - last_publish).count();
+			uint64_t points = m_sampler.total_points();
+			double samples_per_second = controls.running && seconds > 0.0 ? (double)(points - last_published_points) / seconds : 0.0;
+			if (m_region)
+				samples_per_second = controls.running ? shared_rate : 0.0;
+			publish(samples_per_second, batch_size, target_reached, controls);
+
+			last_publish = now;
+			last_published_points = points;
+			publish_now = false;
+		}
+	}
+}
+
+void Simulation::restart(uint32_t display_size)
+{
+	m_sampler.reset(display_size);
+	m_sampler.set_display_size(display_size);
+}
+
+void Simulation::publish(double samples_per_second, uint64_t batch_size, bool target_reached, const Controls &controls)
+{
+	ProfileScope scope("Publish");
+
+	EstimateStatistics statistics = m_sampler.statistics(controls.confidence_z);
+	if (controls.metrics)
+	{
+		MetricsSnapshot &metrics = controls.metrics->snapshot();
+		metrics.total_points = m_sampler.total_points();
+		metrics.inside_circle = m_sampler.inside_circle();
+		metrics.statistics = statistics;
+		metrics.samples_per_second = samples_per_second;
+		metrics.confidence = controls.confidence;
+		metrics.grid_size = m_sampler.size();
+		metrics.thread_count = m_sampler.thread_count();
+		metrics.sampling_mode = m_sampler.sampling_mode();
+		metrics.sampling_strategy = m_sampler.sampling_strategy();
+		metrics.accumulation_bytes = m_sampler.accumulation_bytes();
+		metrics.running = controls.running;
+		controls.metrics->publish();
+	}
+
+	SimulationSnapshot &snapshot = m_snapshots.write_buffer();
+	snapshot.generation = ++m_generation;
+	snapshot.grid_size = m_sampler.size();
+	snapshot.sampling_mode = m_sampler.sampling_mode();
+	snapshot.sampling_strategy = m_sampler.sampling_strategy();
+	snapshot.total_points = m_sampler.total_points();
+	snapshot.inside_circle = m_sampler.inside_circle();
+	snapshot.statistics = statistics;
+	snapshot.target_samples = controls.target_precision > 0.0 ? m_sampler.samples_for_precision(controls.target_precision, controls.confidence_z) : 0;
+	snapshot.samples_per_second = samples_per_second;
+	snapshot.batch_size = batch_size;
+	snapshot.target_reached = target_reached;
+	snapshot.period_reached = !m_region && m_sampler.total_points() >= sample_period(m_sampler.sampling_mode());
+	snapshot.target_stops = m_target_stops;
+	snapshot.attached = m_region != nullptr;
+	snapshot.shared_workers = m_shared_workers;
+	snapshot.checkpoint_points = m_checkpoint_writer.written_points();
+	snapshot.checkpoint_failures = m_checkpoint_writer.failures();
+	snapshot.frames_written = m_frame_exporter ? m_frame_exporter->written() : 0;
+	snapshot.frames_dropped = m_frame_exporter ? m_frame_exporter->dropped() : 0;
+	snapshot.frame_failures = m_frame_exporter ? m_frame_exporter->failures() : 0;
+
+	if (m_resolve_enabled.load(std::memory_order_relaxed))
+	{
+		// The slot still holds the image from its last publish: bring only stale tiles up to date
+		uint64_t since = snapshot.pixels_version;
+		if (snapshot.size != m_sampler.display_size())
+		{
+			snapshot.size = m_sampler.display_size();
+			snapshot.pixels.resize((size_t)snapshot.size * snapshot.size);
+			since = 0;
+		}
+		ProfileScope resolve_scope("Resolve");
+		m_sampler.resolve(snapshot.pixels.data(), since);
+		snapshot.pixels_version = m_sampler.version();
+		snapshot.tiles_per_row = m_sampler.tiles_per_row();
+		snapshot.tile_versions = m_sampler.tile_versions();
+	}
+
+	m_snapshots.publish();
+}
+
+void Simulation::submit_checkpoint(const std::string &path)
+{
+	// Only the copy happens on this thread, the writer thread does the file I/O
+	ProfileScope scope("Checkpoint copy");
+	m_sampler.save(m_checkpoint_writer.state());
+	m_checkpoint_writer.submit(path);
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "BatchScheduler.h"
+#include "Checkpoint.h"
+#include "ConvergenceHistory.h"
+#include "FrameExporter.h"
+#include "MetricsServer.h"
+#include "Sampler.h"
+#include "SharedRegion.h"
+#include "Statistics.h"
+#include "TripleBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SimulationSnapshot
+{
+	uint64_t generation = 0;
+	uint32_t size = 0; // Of the image
+	uint32_t grid_size = 0; // Of the run's counts, a multiple of size
+	SamplingMode sampling_mode = SamplingMode::Pcg64;
+	SamplingStrategy sampling_strategy = SamplingStrategy::Plain;
+	uint64_t total_points = 0;
+	uint64_t inside_circle = 0;
+	EstimateStatistics statistics; // Of the run's strategy, at the set_target_precision() confidence
+	uint64_t target_samples = 0; // Projected samples for the precision target, if there is one
+	double samples_per_second = 0.0;
+	uint64_t batch_size = 0; // Of the last batch, which the scheduler sizes in adaptive mode
+	uint64_t checkpoint_points = 0; // total_points of the newest checkpoint on disk
+	uint64_t checkpoint_failures = 0;
+	bool target_reached = false; // The interval is at least as narrow as the target
+	uint64_t target_stops = 0; // Times the run stopped itself at the target or the sample period
+	bool period_reached = false; // The run holds every sample its mode has, see sample_period()
+	uint64_t frames_written = 0; // Of the frame export, see set_frame_export()
+	uint64_t frames_dropped = 0;
+	uint64_t frame_failures = 0;
+	bool attached = false; // Showing a shared region instead of sampling
+	uint32_t shared_workers = 0; // Live worker processes of the attached region
+
+	// size * size RGBA8888 pixels, current as of Sampler version pixels_version.
+	// Tiles whose entry in tile_versions is newer than what a consumer last copied have
+	// changed; the rest are identical to the previous snapshot.
+	std::vector<uint32_t> pixels;
+	uint64_t pixels_version = 0;
+	uint32_t tiles_per_row = 0;
+	std::vector<uint64_t> tile_versions;
+};
+
+// Runs a Sampler on its own thread, sampling back to back in batches, and publishes
+// counters plus a resolved image through a triple buffer at most s_publish_interval
+// apart. The UI never blocks the sampler and a slow UI frame only skips snapshots.
+// Controls are queued and applied between batches.
+//
+// Each triple-buffer slot remembers the version it was last resolved at, so a publish
+// only re-resolves the tiles that changed since that slot was last written.
+class Simulation
+{
+public:
+	Simulation(uint32_t size, uint32_t thread_count, uint32_t seed = 0);
+	~Simulation();
+
+	Simulation(const Simulation &) = delete;
+	Simulation &operator=(const Simulation &) = delete;
+
+	// A Random or RandomExact run stops on its own after sample_period() samples
+	void set_running(bool running);
+	void set_batch_size(uint64_t batch_size);
+	// Sizes every batch to take about `seconds` instead of using the fixed batch size;
+	// 0 goes back to the fixed size
+	void set_batch_budget(double seconds);
+	void set_thread_count(uint32_t thread_count);
+	void set_colors(Color inside, Color outside);
+	// Stops the run on its own once the confidence interval's half-width (see
+	// Statistics.h) is at most `epsilon`; 0 runs without a target. The last batches are
+	// shortened to what the projection says is still missing.
+	void set_target_precision(double epsilon, double confidence = 0.95);
+	// Starts a new run with the sample points drawn from `mode`
+	void set_sampling_mode(SamplingMode mode);
+	// Starts a new run spread over the square by `strategy` (see Strategy.h); a grid size
+	// the strategy does not support keeps the current one
+	void set_sampling_strategy(SamplingStrategy strategy);
+	// Starts a new run shown at `size`, see set_display_size()
+	void reset(uint32_t size);
+	// Shows the run at another image size. A smaller power of two than the run's grid is
+	// summed from the counts so far, see Sampler::set_display_size(); any other size starts
+	// a new run on a grid of that size.
+	void set_display_size(uint32_t size);
+
+	// Continues a saved run (see read_checkpoint()) from the next batch on
+	void restore(SamplerState state);
+
+	// Shows the combined run of the worker processes sharing the region at `path` (see
+	// SharedRegion.h) instead of sampling, re-reading it every s_attach_interval while
+	// running. An empty path detaches and goes back to an empty run of its own.
+	void attach(std::string path);
+
+	// Writes a checkpoint of the run to `path` every `interval_seconds` on a background
+	// thread, and a last one when the simulation is destroyed. An empty path turns it off.
+	void set_checkpoint(std::string path, double interval_seconds);
+	void checkpoint_now();
+
+	// Writes the image as <prefix>NNNNNN.<format> every `interval` samples, NNNNNN being
+	// the sample count / interval, through a FrameExporter. Batches end on those sample
+	// counts, so each frame shows exactly that many samples. Frames the exporter has no
+	// buffer for are dropped, sampling never waits for the disk. An empty prefix stops.
+	void set_frame_export(std::string prefix, ImageFormat format, uint64_t interval);
+
+	// Publishes the run's counters to `server` along with every snapshot; nullptr stops.
+	// The server must outlive the simulation or a later set_metrics() call.
+	void set_metrics(MetricsServer *server);
+
+	// Turn off while nobody looks at the image: snapshots then only refresh the counters
+	void set_resolve_enabled(bool enabled) { m_resolve_enabled.store(enabled, std::memory_order_relaxed); }
+
+	// Consumer side: picks up the newest snapshot, returns false if nothing new was
+	// published. snapshot() stays valid until the next call.
+	bool update_snapshot() { return m_snapshots.update(); }
+	const SimulationSnapshot &snapshot() const { return m_snapshots.read_buffer(); }
+
+	// Estimate after every batch since the run started, readable from any thread
+	const ConvergenceHistory &history() const { return m_history; }
+
+private:
+	struct Controls
+	{
+		bool running = true;
+		bool stop = false;
+		uint64_t batch_size = 1 << 16;
+		double batch_budget = 0.0;
+		double target_precision = 0.0;
+		double confidence = 0.95;
+		double confidence_z = 1.96;
+		uint32_t thread_count = 1;
+		Color inside_color;
+		Color outside_color;
+		bool colors_changed = false;
+		SamplingMode sampling_mode = SamplingMode::Pcg64;
+		bool sampling_mode_changed = false;
+		SamplingStrategy sampling_strategy = SamplingStrategy::Plain;
+		bool sampling_strategy_changed = false;
+		uint32_t reset_size = 0;
+		bool reset_requested = false;
+		uint32_t display_size = 0;
+		bool display_size_changed = false;
+		std::shared_ptr<SamplerState> restore_state;
+		std::string checkpoint_path;
+		double checkpoint_interval = 0.0;
+		bool checkpoint_requested = false;
+		std::string attach_path;
+		bool attach_changed = false;
+		std::string frame_prefix;
+		ImageFormat frame_format = ImageFormat::Png;
+		uint64_t frame_interval = 0;
+		bool frame_export_changed = false;
+		MetricsServer *metrics = nullptr;
+	};
+
+	void thread_loop();
+	void restart(uint32_t display_size);
+	void publish(double samples_per_second, uint64_t batch_size, bool target_reached, const Controls &controls);
+	void submit_checkpoint(const std::string &path);
+
+	template <typename Update>
+	void change_controls(Update update);
+
+private:
+	static constexpr std::chrono::milliseconds s_publish_interval{16};
+	// Smallest batch once a precision target is close, the projection is only an estimate
+	static constexpr uint64_t s_min_target_batch = 1 << 16;
+	static constexpr std::chrono::milliseconds s_attach_interval{100};
+
+	Sampler m_sampler;
+	BatchScheduler m_scheduler;
+	CheckpointWriter m_checkpoint_writer;
+	TripleBuffer<SimulationSnapshot> m_snapshots;
+	ConvergenceHistory m_history;
+	uint64_t m_generation = 0;
+	uint64_t m_target_stops = 0;
+	std::unique_ptr<FrameExporter> m_frame_exporter;
+	uint64_t m_frame_interval = 0;
+	uint64_t m_next_frame = 0; // Sample count of the next frame
+	std::unique_ptr<SharedRegion> m_region; // Attached region, only used by the thread
+	uint32_t m_shared_workers = 0;
+	std::atomic<bool> m_resolve_enabled = true;
+
+	std::mutex m_controls_mutex;
+	std::condition_variable m_controls_wake;
+	Controls m_controls;
+	std::atomic<bool> m_controls_changed = false;
+
+	std::thread m_thread;
+};
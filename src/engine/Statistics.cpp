@@ -0,0 +1,117 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+double confidence_z(double confidence)
+{
+	// Bisection on erfc; only called when the confidence level changes
+	double tail = 1.0 - std::clamp(confidence, 0.5, 1.0 - 1e-12);
+	double low = 0.0;
+	double high = 10.0;
+	for (int i = 0; i < 64; ++i)
+	{
+		double z = 0.5 * (low + high);
+		if (std::erfc(z / std::sqrt(2.0)) > tail)
+			low = z;
+		else
+			high = z;
+	}
+	return 0.5 * (low + high);
+}
+
+EstimateStatistics estimate_statistics(uint64_t inside, uint64_t total, double z)
+{
+	EstimateStatistics statistics;
+	if (total == 0)
+		return statistics;
+
+	double n = (double)total;
+	double p = (double)inside / n;
+	statistics.estimate = 4.0 * p;
+	statistics.variance = 16.0 * p * (1.0 - p) / n;
+	statistics.standard_error = std::sqrt(statistics.variance);
+
+	double z2 = z * z;
+	double center = (p + z2 / (2.0 * n)) / (1.0 + z2 / n);
+	double spread = z / (1.0 + z2 / n) * std::sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n));
+	statistics.lower = 4.0 * std::max(0.0, center - spread);
+	statistics.upper = 4.0 * std::min(1.0, center + spread);
+	statistics.half_width = 4.0 * spread;
+	return statistics;
+}
+
+EstimateStatistics normal_statistics(double estimate, double variance, double z)
+{
+	EstimateStatistics statistics;
+	statistics.estimate = estimate;
+	statistics.variance = std::max(variance, 0.0);
+	statistics.standard_error = std::sqrt(statistics.variance);
+	statistics.half_width = z * statistics.standard_error;
+	statistics.lower = std::max(0.0, estimate - statistics.half_width);
+	statistics.upper = std::min(4.0, estimate + statistics.half_width);
+	return statistics;
+}
+
+EstimateStatistics antithetic_statistics(uint64_t inside, uint64_t inside_pairs, uint64_t total, double z)
+{
+	uint64_t pairs = total / 2;
+	if (pairs < s_min_antithetic_pairs)
+		return estimate_statistics(inside, total, z);
+
+	double p = (double)inside / (double)total;
+	double n = (double)pairs;
+	double mean_square = ((double)inside + 2.0 * (double)inside_pairs) / n;
+	double pair_variance = (mean_square - 4.0 * p * p) * n / (n - 1.0);
+	// The estimate is 4 * mean(y) / 2
+	return normal_statistics(4.0 * p, 4.0 * pair_variance / n, z);
+}
+
+uint64_t samples_for_precision(uint64_t inside, uint64_t total, double epsilon, double z)
+{
+	double p = total > 0 ? (double)inside / (double)total : 0.5;
+	double needed = std::ceil(16.0 * z * z * p * (1.0 - p) / (epsilon * epsilon));
+	// A fraction of exactly 0 or 1 projects to no samples; the interval still has width
+	needed = std::max(needed, z * z / epsilon);
+	return needed >= 1.8e19 ? UINT64_MAX : (uint64_t)needed;
+}
+
+uint64_t samples_for_precision(const EstimateStatistics &statistics, uint64_t total, double epsilon)
+{
+	double ratio = statistics.half_width / epsilon;
+	double needed = std::ceil((double)total * ratio * ratio);
+	return needed >= 1.8e19 ? UINT64_MAX : (uint64_t)needed;
+}
+
+EstimatorSpread estimator_spread(const uint64_t *inside, uint32_t estimators, uint64_t samples)
+{
+	EstimatorSpread spread;
+	if (estimators == 0 || samples == 0)
+		return spread;
+
+	double sum = 0.0;
+	spread.minimum = 4.0;
+	spread.maximum = 0.0;
+	for (uint32_t k = 0; k < estimators; ++k)
+	{
+		double estimate = 4.0 * (double)inside[k] / (double)samples;
+		sum += estimate;
+		spread.minimum = std::min(spread.minimum, estimate);
+		spread.maximum = std::max(spread.maximum, estimate);
+	}
+	spread.mean = sum / estimators;
+
+	// Two passes, the estimates agree to many digits
+	double squares = 0.0;
+	for (uint32_t k = 0; k < estimators; ++k)
+	{
+		double deviation = 4.0 * (double)inside[k] / (double)samples - spread.mean;
+		squares += deviation * deviation;
+	}
+	spread.empirical_standard_error = estimators > 1 ? std::sqrt(squares / (estimators - 1)) : 0.0;
+	spread.mean_standard_error = spread.empirical_standard_error / std::sqrt((double)estimators);
+
+	double p = std::acos(-1.0) / 4.0;
+	spread.theoretical_standard_error = 4.0 * std::sqrt(p * (1.0 - p) / (double)samples);
+	return spread;
+}
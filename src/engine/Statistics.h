@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// Confidence interval of the estimate 4 * inside / total. Each sample is a Bernoulli
+// trial, so the two counts are all the streaming state needed: the interval is the
+// Wilson score interval of the inside fraction, scaled by 4. Unlike the plain normal
+// interval it does not collapse to zero width while the fraction is still 0 or 1 after
+// only a few samples.
+//
+// The variance assumes independent samples. For the low-discrepancy modes the real error
+// is far smaller, so their interval is conservative.
+struct EstimateStatistics
+{
+	double estimate = 0.0;
+	double variance = 0.0; // Of the estimate, 16 p (1 - p) / total
+	double standard_error = 0.0;
+	double lower = 0.0;
+	double upper = 4.0;
+	double half_width = 2.0;
+};
+
+// Two-sided standard normal quantile, e.g. 1.96 for a confidence of 0.95
+double confidence_z(double confidence);
+
+EstimateStatistics estimate_statistics(uint64_t inside, uint64_t total, double z);
+
+// Normal interval estimate +/- z * sqrt(variance), clipped to [0, 4], for the estimators
+// of the sampling strategies (see Strategy.h)
+EstimateStatistics normal_statistics(double estimate, double variance, double z);
+
+// Antithetic pairs: the pairs' inside counts y (0, 1 or 2) are the independent draws, and
+// sum(y^2) = inside + 2 * inside_pairs. Until s_min_antithetic_pairs pairs are in, the
+// Wilson interval of the counts stands in, conservatively.
+static constexpr uint64_t s_min_antithetic_pairs = 64;
+EstimateStatistics antithetic_statistics(uint64_t inside, uint64_t inside_pairs, uint64_t total, double z);
+
+// Samples the whole run needs for a half-width of `epsilon`, projected from the current
+// inside fraction (or the worst case 1/2 before the first sample)
+uint64_t samples_for_precision(uint64_t inside, uint64_t total, double epsilon, double z);
+// The same from any estimator's interval, whose width shrinks as 1 / sqrt(total)
+uint64_t samples_for_precision(const EstimateStatistics &statistics, uint64_t total, double epsilon);
+
+// Spread of independent estimates 4 * inside[k] / samples, e.g. one per seed. The
+// empirical standard error is their sample standard deviation, the theoretical one is
+// 4 sqrt(p (1 - p) / samples) at p = pi / 4; they agree when the samples are independent.
+struct EstimatorSpread
+{
+	double mean = 0.0;
+	double minimum = 0.0;
+	double maximum = 0.0;
+	double empirical_standard_error = 0.0;
+	double theoretical_standard_error = 0.0;
+	double mean_standard_error = 0.0; // Of the mean of all estimates
+};
+
+EstimatorSpread estimator_spread(const uint64_t *inside, uint32_t estimators, uint64_t samples);
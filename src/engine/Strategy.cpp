@@ -0,0 +1,208 @@
+#include "Strategy.h"
+#include "GridLayout.h"
+#include "RandomPolicies.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string.h>
+
+static const char *const s_strategy_names[] = {"plain", "quadrant", "antithetic", "stratified", "band"};
+static_assert(sizeof(s_strategy_names) / sizeof(s_strategy_names[0]) == (size_t)SamplingStrategy::Count);
+
+const char *sampling_strategy_name(SamplingStrategy strategy)
+{
+	return strategy < SamplingStrategy::Count ? s_strategy_names[(uint32_t)strategy] : "unknown";
+}
+
+bool parse_sampling_strategy(const char *name, SamplingStrategy &strategy)
+{
+	for (uint32_t i = 0; i < (uint32_t)SamplingStrategy::Count; ++i)
+	{
+		if (strcmp(name, s_strategy_names[i]) == 0)
+		{
+			strategy = (SamplingStrategy)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool supports_size(SamplingStrategy strategy, uint32_t size)
+{
+	if (is_stratified(strategy))
+		return size > 0 && size % 2 == 0;
+	return !is_folded(strategy) || size % 2 == 0;
+}
+
+PixelClass classify_pixel(uint32_t x, uint32_t y, uint32_t size)
+{
+	uint64_t radius = (uint64_t)size * size;
+	if ((uint64_t)(x + 1) * (x + 1) + (uint64_t)(y + 1) * (y + 1) <= radius)
+		return PixelClass::Inside;
+	if ((uint64_t)x * x + (uint64_t)y * y >= radius)
+		return PixelClass::Outside;
+	return PixelClass::Edge;
+}
+
+// Largest x with x^2 <= value; exact for the value range of a grid (below 2^53)
+static uint64_t FloorSqrt(uint64_t value)
+{
+	uint64_t root = (uint64_t)std::sqrt((double)value);
+	while (root * root > value)
+		root--;
+	while ((root + 1) * (root + 1) <= value)
+		root++;
+	return root;
+}
+
+void StrataLayout::build(SamplingStrategy strategy, uint32_t size)
+{
+	m_size = size;
+	m_edge_only = strategy == SamplingStrategy::BoundaryBand;
+	m_inside_pixels = 0;
+	m_edge_pixels.clear();
+	m_edge_cells.clear();
+
+	// Row y is inside up to the far corner's column and edge up to the near corner's
+	uint64_t radius = (uint64_t)size * size;
+	uint32_t tiles_per_row = GridLayout::tiles_per_row(size);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		uint64_t inside_end = FloorSqrt(radius - (uint64_t)(y + 1) * (y + 1));
+		uint64_t outside_begin = FloorSqrt(radius - (uint64_t)y * y - 1) + 1;
+		m_inside_pixels += inside_end;
+		for (uint32_t x = (uint32_t)inside_end; x < std::min<uint64_t>(outside_begin, size); ++x)
+		{
+			if (m_edge_only)
+				m_edge_pixels.push_back((y << 16) | x);
+			m_edge_cells.push_back(GridLayout::cell_index(x, y, tiles_per_row));
+		}
+	}
+
+	m_count = m_edge_only ? m_edge_pixels.size() : (uint64_t)size * size;
+	m_step = std::clamp<uint64_t>((uint64_t)std::llround((double)m_count * 0.6180339887498949), 1, std::max<uint64_t>(m_count, 1));
+	while (m_count > 1 && std::gcd(m_step, m_count) != 1)
+		m_step++;
+}
+
+static inline double Fraction(uint64_t coord)
+{
+	return ((double)(coord >> 11) + 0.5) * 0x1p-53;
+}
+
+static inline bool IsInsideQuadrant(uint64_t x, uint64_t y)
+{
+	double x_coord = Fraction(x);
+	double y_coord = Fraction(y);
+	return x_coord * x_coord + y_coord * y_coord <= 1.0;
+}
+
+static inline uint32_t PixelOf(uint64_t coord, uint32_t size)
+{
+	return (uint32_t)(((coord >> 32) * size) >> 32);
+}
+
+static constexpr uint32_t s_block_size = 4096;
+
+// One block of samples; `cell_indices` is null when only counting. Returns the
+// antithetic pairs with both points inside.
+static uint64_t ClassifyBlock(const StrategyRun &run, uint64_t first_sample, uint32_t count, uint32_t *cell_indices, uint32_t *inside)
+{
+	uint64_t x[s_block_size + 1];
+	uint64_t y[s_block_size + 1];
+	uint32_t tiles_per_row = GridLayout::tiles_per_row(run.size);
+	uint64_t inside_pairs = 0;
+
+	if (run.strategy == SamplingStrategy::Antithetic)
+	{
+		// Point k serves samples 2k and 2k + 1, the odd one mirrored
+		uint64_t first_point = first_sample / 2;
+		uint64_t last_point = (first_sample + count - 1) / 2;
+		sequence_points(run.mode, run.seed, first_point, (uint32_t)(last_point - first_point + 1), x, y);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint64_t sample = first_sample + i;
+			uint64_t point = sample / 2 - first_point;
+			bool mirrored = sample & 1;
+			uint64_t x_coord = mirrored ? ~x[point] : x[point];
+			uint64_t y_coord = mirrored ? ~y[point] : y[point];
+			inside[i] = IsInsideQuadrant(x_coord, y_coord);
+			if (mirrored)
+				inside_pairs += inside[i] & (uint32_t)IsInsideQuadrant(x[point], y[point]);
+			if (cell_indices)
+				cell_indices[i] = GridLayout::cell_index(PixelOf(x_coord, run.size), PixelOf(y_coord, run.size), tiles_per_row);
+		}
+		return inside_pairs;
+	}
+
+	// The point is the jitter within the stratum's pixel, tested in pixel units. Random
+	// modes take point i. Consecutive points of a low-discrepancy sequence are spread out
+	// together and would line up with the order the strata are visited in, so a stratum
+	// takes point s on its s-th visit instead, shifted by a random offset of its own.
+	const StrataLayout &strata = *run.strata;
+	bool rotated = is_low_discrepancy(run.mode);
+	uint64_t sweep = first_sample / strata.count();
+	uint64_t stratum = first_sample % strata.count();
+	if (rotated)
+		sequence_points(run.mode, run.seed, sweep, (uint32_t)((first_sample + count - 1) / strata.count() - sweep + 1), x, y);
+	else
+		sequence_points(run.mode, run.seed, first_sample, count, x, y);
+
+	double radius = (double)run.size * run.size;
+	uint64_t position = stratum * strata.step() % strata.count();
+	uint32_t point = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t pixel_x, pixel_y;
+		strata.pixel(position, pixel_x, pixel_y);
+		uint64_t x_bits = x[rotated ? point : i];
+		uint64_t y_bits = y[rotated ? point : i];
+		if (rotated)
+		{
+			uint64_t mix = ((uint64_t)run.seed << 40) ^ position;
+			x_bits += splitmix64(mix);
+			y_bits += splitmix64(mix);
+		}
+		double x_coord = pixel_x + Fraction(x_bits);
+		double y_coord = pixel_y + Fraction(y_bits);
+		inside[i] = x_coord * x_coord + y_coord * y_coord <= radius;
+		if (cell_indices)
+			cell_indices[i] = GridLayout::cell_index(pixel_x, pixel_y, tiles_per_row);
+
+		position += strata.step();
+		if (position >= strata.count())
+			position -= strata.count();
+		if (++stratum == strata.count())
+		{
+			stratum = 0;
+			point++;
+		}
+	}
+	return 0;
+}
+
+uint64_t count_inside_strategy(const StrategyRun &run, uint64_t first_sample, uint64_t count, uint64_t &inside_pairs)
+{
+	uint32_t inside[s_block_size];
+	uint64_t inside_circle = 0;
+	for (uint64_t offset = 0; offset < count; offset += s_block_size)
+	{
+		uint32_t block = (uint32_t)std::min<uint64_t>(s_block_size, count - offset);
+		inside_pairs += ClassifyBlock(run, first_sample + offset, block, nullptr, inside);
+		for (uint32_t i = 0; i < block; ++i)
+			inside_circle += inside[i];
+	}
+	return inside_circle;
+}
+
+uint64_t classify_strategy(const StrategyRun &run, uint64_t first_sample, uint32_t count, uint32_t *cell_indices, uint32_t *inside)
+{
+	uint64_t inside_pairs = 0;
+	for (uint32_t offset = 0; offset < count; offset += s_block_size)
+	{
+		uint32_t block = std::min(s_block_size, count - offset);
+		inside_pairs += ClassifyBlock(run, first_sample + offset, block, cell_indices + offset, inside + offset);
+	}
+	return inside_pairs;
+}
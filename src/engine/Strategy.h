@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Sequence.h"
+
+#include <cstdint>
+#include <vector>
+
+// How the samples of a run are spread over the square, on top of where the points come
+// from (SamplingMode). Plain throws them at all of [-1,1]^2. The others only sample the
+// quadrant [0,1]^2, whose quarter circle holds the same fraction of its area, and mirror
+// it into the other three for display; a grid of half the size holds the same image.
+//
+// Quadrant: the plain samples folded, (|x|, |y|). The estimate is exactly Plain's; only
+// the image gains, each pixel having four times the samples.
+// Antithetic: samples 2k and 2k + 1 are point k and its mirror (1 - x, 1 - y). Being
+// inside is monotone in both coordinates, so the two are negatively correlated and their
+// mean varies about 27% less than that of two independent samples.
+// Stratified: one sample per grid pixel per sweep, jittered within the pixel by the
+// sampling mode's point i, or for a low-discrepancy mode by point s (the sweep) shifted
+// by a random offset per pixel. Only pixels the circle's edge crosses contribute
+// variance, about 2 per row, so with a folded grid of n x n pixels the variance drops
+// about n / 2 times.
+// BoundaryBand: stratified over the edge pixels alone; pixels entirely inside are counted
+// exactly and the ones entirely outside are left out, about n^2 / 4 times less variance.
+//
+// Each strategy has its own estimate and variance, see Sampler::statistics().
+enum class SamplingStrategy : uint32_t
+{
+	Plain,
+	Quadrant,
+	Antithetic,
+	Stratified,
+	BoundaryBand,
+	Count,
+};
+
+const char *sampling_strategy_name(SamplingStrategy strategy);
+bool parse_sampling_strategy(const char *name, SamplingStrategy &strategy);
+
+inline bool is_folded(SamplingStrategy strategy)
+{
+	return strategy != SamplingStrategy::Plain;
+}
+
+inline bool is_stratified(SamplingStrategy strategy)
+{
+	return strategy == SamplingStrategy::Stratified || strategy == SamplingStrategy::BoundaryBand;
+}
+
+// A folded grid needs an even size and the strata are its pixels, so the stratified
+// strategies cannot only count
+bool supports_size(SamplingStrategy strategy, uint32_t size);
+
+// Width of the grid a run of `size` pixels keeps its counts in
+inline uint32_t grid_width(SamplingStrategy strategy, uint32_t size)
+{
+	return is_folded(strategy) ? size / 2 : size;
+}
+
+enum class PixelClass
+{
+	Inside,
+	Edge,
+	Outside,
+};
+
+// Pixel (x, y) of a size x size grid over [0,1]^2, exactly: inside when its far corner
+// is in the circle, outside when its near corner is not
+PixelClass classify_pixel(uint32_t x, uint32_t y, uint32_t size);
+
+// Strata of a stratified run on a size x size folded grid: every pixel, or only the edge
+// pixels for BoundaryBand. Sample i lands in stratum i mod count(). Strata are visited a
+// fixed step of about 0.618 count() apart rather than in row order, so every run of
+// samples, even a partial sweep, is spread over the whole quarter circle.
+class StrataLayout
+{
+public:
+	void build(SamplingStrategy strategy, uint32_t size);
+
+	uint32_t size() const { return m_size; }
+	uint64_t count() const { return m_count; }
+	uint64_t step() const { return m_step; }
+
+	// Pixel of the stratum at `position` in row order
+	void pixel(uint64_t position, uint32_t &x, uint32_t &y) const
+	{
+		if (m_edge_only)
+		{
+			x = m_edge_pixels[position] & 0xffff;
+			y = m_edge_pixels[position] >> 16;
+		}
+		else
+		{
+			x = (uint32_t)(position % m_size);
+			y = (uint32_t)(position / m_size);
+		}
+	}
+
+	uint64_t inside_pixels() const { return m_inside_pixels; }
+	// GridLayout cells of the edge pixels, in row order
+	const std::vector<uint32_t> &edge_cells() const { return m_edge_cells; }
+
+private:
+	uint32_t m_size = 0;
+	bool m_edge_only = false;
+	uint64_t m_count = 0;
+	uint64_t m_step = 1;
+	uint64_t m_inside_pixels = 0;
+	std::vector<uint32_t> m_edge_pixels; // (y << 16) | x
+	std::vector<uint32_t> m_edge_cells;
+};
+
+// Everything the kernels below need to know about a run with a strategy of its own
+struct StrategyRun
+{
+	SamplingStrategy strategy = SamplingStrategy::Antithetic;
+	SamplingMode mode = SamplingMode::Pcg64;
+	uint32_t seed = 0;
+	uint32_t size = 0; // Of the folded grid
+	const StrataLayout *strata = nullptr; // For the stratified strategies
+};
+
+// Same contracts as count_inside() and classify_points() in SimdKernel.h, for Antithetic
+// and the stratified strategies, in scalar code: points are tested in double like the
+// sequences'; Quadrant uses the plain kernels (see Sampler). Antithetic
+// pairs that end in the range (at an odd sample) with both points inside are added to
+// `inside_pairs`, or returned by classify_strategy(); other strategies have none.
+uint64_t count_inside_strategy(const StrategyRun &run, uint64_t first_sample, uint64_t count, uint64_t &inside_pairs);
+uint64_t classify_strategy(const StrategyRun &run, uint64_t first_sample, uint32_t count, uint32_t *cell_indices, uint32_t *inside);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer triple buffer. The producer fills its private
+// slot and publishes it by swapping it with the shared middle slot; the consumer swaps its
+// own slot with the middle one when something new was published. Neither side ever waits,
+// and the consumer always sees the latest complete value.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer side
+	T &write_buffer() { return m_buffers[m_write]; }
+	uint32_t write_index() const { return m_write; }
+
+	void publish()
+	{
+		uint8_t previous = m_middle.exchange(m_write | s_fresh, std::memory_order_acq_rel);
+		m_write = previous & s_index_mask;
+	}
+
+	// Consumer side: takes the latest published value, returns false if nothing new
+	bool update()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & s_fresh) == 0)
+			return false;
+		uint8_t previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+		m_read = previous & s_index_mask;
+		return true;
+	}
+
+	const T &read_buffer() const { return m_buffers[m_read]; }
+
+private:
+	static constexpr uint8_t s_fresh = 4;
+	static constexpr uint8_t s_index_mask = 3;
+
+	std::array<T, 3> m_buffers;
+	uint8_t m_write = 0;
+	uint8_t m_read = 1;
+	std::atomic<uint8_t> m_middle = 2;
+};
@@ -0,0 +1,87 @@
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+WorkerPool::WorkerPool(uint32_t thread_count)
+{
+	// The calling thread takes part in run(), so it counts as one of the workers
+	for (uint32_t i = 1; i < thread_count; ++i)
+		m_threads.emplace_back(&WorkerPool::worker_loop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread &thread : m_threads)
+		thread.join();
+}
+
+void WorkerPool::run(uint32_t task_count, const std::function<void(uint32_t)> &task)
+{
+	if (m_threads.empty() || task_count <= 1)
+	{
+		for (uint32_t i = 0; i < task_count; ++i)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_task = &task;
+		m_task_count = task_count;
+		m_next_task = 0;
+		m_busy_workers = (uint32_t)m_threads.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	execute();
+
+	// Every worker checks in before returning, so none can straggle into the next run
+	std::unique_lock lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busy_workers == 0; });
+	m_task = nullptr;
+}
+
+uint32_t WorkerPool::hardware_threads()
+{
+	uint32_t count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+void WorkerPool::worker_loop()
+{
+	profile_set_thread_name("Worker");
+
+	uint64_t seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != seen_generation; });
+			if (m_stop)
+				return;
+			seen_generation = m_generation;
+		}
+
+		execute();
+
+		std::lock_guard lock(m_mutex);
+		if (--m_busy_workers == 0)
+			m_done.notify_one();
+	}
+}
+
+void WorkerPool::execute()
+{
+	while (true)
+	{
+		uint32_t index = m_next_task.fetch_add(1);
+		if (index >= m_task_count)
+			return;
+		(*m_task)(index);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of persistent threads. run() hands out task indices to the pool and the
+// calling thread, and returns once every task has finished.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(uint32_t thread_count);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	void run(uint32_t task_count, const std::function<void(uint32_t)> &task);
+
+	uint32_t thread_count() const { return (uint32_t)m_threads.size() + 1; }
+
+	static uint32_t hardware_threads();
+
+private:
+	void worker_loop();
+	void execute();
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation = 0;
+	uint32_t m_busy_workers = 0;
+	bool m_stop = false;
+
+	const std::function<void(uint32_t)> *m_task = nullptr;
+	uint32_t m_task_count = 0;
+	std::atomic<uint32_t> m_next_task = 0;
+};
@@ -1,8 +1,26 @@
 #include "App.h"
 
-int main()
+#include <string.h>
+
+int main(int argc, char **argv)
 {
-	App app;
+	// --checkpoint <file>: resume from the file if it exists and keep saving the run to it
+	// --attach <file>: view the combined run of the CLI workers sharing the region in the file
+	// --metrics <address>: serve the run's metrics for Prometheus, see MetricsServer.h
+	const char *checkpoint_path = nullptr;
+	const char *attach_path = nullptr;
+	const char *metrics_address = nullptr;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--checkpoint"))
+			checkpoint_path = argv[++i];
+		else if (!strcmp(argv[i], "--attach"))
+			attach_path = argv[++i];
+		else if (!strcmp(argv[i], "--metrics"))
+			metrics_address = argv[++i];
+	}
+
+	App app(checkpoint_path, attach_path, metrics_address);
 	app.run();
 	return 0;
-}
\ No newline at end of file
+}